@@ -0,0 +1,283 @@
+// T9 beam decoder -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#ifndef CPP_T9_BEAM_HPP
+#define CPP_T9_BEAM_HPP
+
+#include <cstdint>
+#include <deque>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace t9 {
+class Model;
+}  // namespace t9
+
+#include "t9/symbols.hpp"
+
+namespace t9 {
+
+/**
+ * Beam search over the corpus symbols of a sequence of T9 keys, keeping the active hypotheses in flat arrays.
+ *
+ * Each hypothesis (beam entry) is one row holding its score, the last (ngram_length - 1) symbols of its path as the
+ * context of the next lookup, and a backpointer into the history of all symbols typed so far. Typing a key expands,
+ * scores and selects all hypotheses in a single linear pass over the rows.
+ *
+ * The decoder finds the same suggestions as the `SearchTree`: Until ngram_length keys were typed, all hypotheses are
+ * kept. Afterwards only the `max_paths` best hypotheses survive each key, their rows stay in the order of the search
+ * tree. Candidates are only materialized if they survive, hence the expansion of the first key that is pruned does not
+ * allocate all n_symbols^ngram_length hypotheses.
+ *
+ * Optionally, hypotheses are recombined by their state: Paths ending in the same (ngram_length - 1) symbols are scored
+ * identically by the language model from then on, hence only the best `paths_per_state` of them can ever win. The
+ * others are dropped while selecting the survivors, which leaves the places of the beam to paths of different states.
+ *
+ * Optionally, the rows replaced by each key are kept as a checkpoint. Erasing the last key swaps them back in, without
+ * recomputing any hypothesis.
+ *
+ * Symbols of pruned hypotheses and of dropped checkpoints remain in the history until it has doubled since it was last
+ * compacted. Compacting keeps only the symbols reachable from the rows and the checkpoints, hence a long-lived decoder
+ * does not grow with the number of typed keys.
+ */
+class BeamDecoder {
+ public:
+  /**
+   * Construct a beam decoder.
+   * @param ngram_length Length of the ngrams to use.
+   * @param max_paths Maximal number of best paths to keep track of.
+   * @param paths_per_state Maximal number of surviving paths ending in the same (ngram_length - 1) symbols. A value of
+   * 0 does not recombine hypotheses.
+   * @param max_checkpoints Maximal number of typed keys that can be erased. Older checkpoints are dropped.
+   */
+  BeamDecoder(size_t ngram_length, size_t max_paths, size_t paths_per_state = 0, size_t max_checkpoints = 0);
+
+  /**
+   * Discard all typed keys. The arrays keep their capacity and are reused for the next search.
+   */
+  void
+  reset();
+
+  /**
+   * Type a sequence of keys and calculate the best text suggestions for the entered keys.
+   * @param sequence Sequence of T9 key identifiers to enter.
+   * @param model Model to be used for searching the best text suggestions.
+   */
+  void
+  type(const t9_symbol_id_sequence &sequence, Model *model);
+
+  /**
+   * Type a single key: Expand all hypotheses by each corpus symbol, score them and select the survivors.
+   * @param key Identifier of the T9 key to type.
+   * @param model T9 model.
+   */
+  void
+  insert(t9_symbol_id key, Model *model);
+
+  /**
+   * Erase the last typed key by restoring the hypotheses of its checkpoint.
+   * @return true if the key was erased, false if no checkpoint is left.
+   */
+  bool
+  erase();
+
+  /**
+   * Get the best paths found for the keys typed so far.
+   * @param paths Collection the corpus symbol sequences and scores of the best paths are written to, best path first.
+   */
+  void
+  best_paths(std::vector<std::pair<t9_symbol_id_sequence, float>> &paths) const;
+
+  /**
+   * Get the number of active hypotheses.
+   * @return Number of rows.
+   */
+  size_t
+  size() const;
+
+  /**
+   * Get the number of keys that can be erased.
+   * @return Number of checkpoints.
+   */
+  size_t
+  n_checkpoints() const;
+
+  /**
+   * Get the number of symbols in the history, including the ones not yet removed by compacting it.
+   * @return Size of the history.
+   */
+  size_t
+  history_size() const;
+
+ protected:
+  /**
+   * Candidate entering the list of best paths.
+   */
+  struct Candidate {
+    // Score (cost) of the path.
+    float score;
+    // Row of the parent hypothesis times the number of corpus symbols plus the symbol of the candidate.
+    size_t id;
+
+    inline bool
+    operator<(const Candidate &other) const {
+      return score < other.score || (score == other.score && id < other.id);
+    }
+  };
+
+  /**
+   * Hash of the context suffix of a hypothesis.
+   */
+  struct SuffixHash {
+    inline size_t
+    operator()(const t9_symbol_id_sequence &suffix) const {
+      std::string_view bytes(reinterpret_cast<const char *>(suffix.data()), suffix.size());
+      return std::hash<std::string_view>()(bytes);
+    }
+  };
+
+  /**
+   * Offer a candidate to the sorted list of best paths while recombining hypotheses. The candidate replaces the worst
+   * path of its state if the state is full, otherwise the worst path of all if the best paths are full.
+   * @param score Score of the candidate.
+   * @param id Identifier of the candidate.
+   * @param n_symbols Number of corpus symbols.
+   */
+  void
+  offer_recombined(float score, size_t id, size_t n_symbols);
+
+  /**
+   * Assign a row to the class of all rows whose contexts end in the same (ngram_length - 2) symbols. Candidates of
+   * rows of the same class with the same symbol share their state.
+   * @param row Row of a hypothesis.
+   * @param n_symbols Number of corpus symbols.
+   */
+  void
+  classify_row(size_t row, size_t n_symbols);
+
+  /**
+   * Remove the symbols from the history that are neither reachable from the rows nor from the checkpoints. The
+   * remaining symbols keep their order, hence truncating the history on erase still drops the symbols of the erased
+   * key only.
+   */
+  void
+  compact_history();
+
+  /**
+   * Get the state of a candidate, identifying the last (ngram_length - 1) symbols of its path.
+   * @param id Identifier of the candidate, its row has to be classified.
+   * @param n_symbols Number of corpus symbols.
+   * @return Index of the state.
+   */
+  inline size_t
+  state_of(size_t id, size_t n_symbols) const {
+    return row_classes[id / n_symbols] * n_symbols + id % n_symbols;
+  }
+
+  /**
+   * Hypotheses before a key was typed.
+   */
+  struct Checkpoint {
+    std::vector<float> scores;
+    std::vector<t9_symbol_id> contexts;
+    std::vector<size_t> positions;
+    std::vector<Candidate> best;
+    // Number of symbols in the history.
+    size_t history_size;
+  };
+
+  /**
+   * Offer a candidate to the bounded max-heap of best paths, the worst candidate on top.
+   * Candidates are offered in the order of the search tree and ties are ranked by their identifiers, hence ties are
+   * resolved like in `SearchPathHeap`.
+   * @param score Score of the candidate.
+   * @param id Identifier of the candidate.
+   */
+  void
+  offer(float score, size_t id);
+
+  /**
+   * Check if a score can not enter the full list of best paths.
+   * @param score Score of a candidate or of the parent of candidates.
+   * @return true if the score can be skipped, false otherwise.
+   */
+  inline bool
+  is_rejected(float score) const {
+    if (best.size() < max_paths) {
+      return false;
+    }
+    // The worst path is on top of the heap, or at the end of the sorted list with recombination.
+    return max_paths == 0 || score >= (is_recombining ? best.back().score : best.front().score);
+  }
+
+  // Length of the ngrams, the context of a hypothesis holds ngram_length - 1 symbols.
+  size_t ngram_length;
+
+  // Maximal number of best scoring paths to keep track of.
+  size_t max_paths;
+
+  // Maximal number of surviving paths per state, 0 if hypotheses are not recombined.
+  size_t paths_per_state;
+
+  // Whether the best paths of the key being typed are selected with recombination, in a sorted list instead of a
+  // heap. Hypotheses are only recombined once pruning starts.
+  bool is_recombining;
+
+  // Maximal number of checkpoints to keep.
+  size_t max_checkpoints;
+
+  // Number of keys typed so far.
+  size_t depth;
+
+  // Score of each hypothesis.
+  std::vector<float> scores;
+
+  // Context of each hypothesis, ngram_length - 1 symbols per row, right aligned.
+  std::vector<t9_symbol_id> contexts;
+
+  // Position of the last symbol of each hypothesis in the history.
+  std::vector<size_t> positions;
+
+  // Symbols of all hypotheses that ever survived and the position of their predecessor. The symbols typed first have
+  // no predecessor.
+  std::vector<t9_symbol_id> history_symbols;
+  std::vector<size_t> history_parents;
+
+  // Size of the history that triggers compacting it.
+  size_t history_limit;
+
+  // Best paths of the last typed key. While typing a key they form a heap, or a sorted list with recombination.
+  // Afterwards they are sorted best path first and their identifiers are rows.
+  std::vector<Candidate> best;
+
+  // Class of each row that has candidates with recombination, and the class of each context suffix.
+  std::vector<size_t> row_classes;
+  std::unordered_map<t9_symbol_id_sequence, size_t, SuffixHash> suffix_classes;
+
+  // Number of best paths and the worst of them in each state with recombination.
+  std::vector<size_t> state_counts;
+  std::vector<Candidate> state_worst;
+
+  // Checkpoints of the last typed keys, the latest at the back.
+  std::deque<Checkpoint> checkpoints;
+
+  // Temporary buffers of the expansion.
+  std::vector<float> costs;
+  std::vector<size_t> survivors;
+  t9_symbol_id_sequence suffix;
+  std::vector<float> next_scores;
+  std::vector<t9_symbol_id> next_contexts;
+  std::vector<size_t> next_positions;
+  std::vector<size_t> history_positions;
+};
+
+}  // namespace t9
+
+#endif //CPP_T9_BEAM_HPP
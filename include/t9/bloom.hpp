@@ -0,0 +1,171 @@
+// T9 bloom filter -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#ifndef CPP_T9_BLOOM_HPP
+#define CPP_T9_BLOOM_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "t9/symbols.hpp"
+#include "t9/frozen.hpp"
+#include "t9/language_model.hpp"
+
+// Number of bits per block of the bloom filter, one block spans a single cache line.
+#define T9_BLOOM_BLOCK_BITS 512
+
+namespace t9 {
+
+/**
+ * Blocked bloom filter of symbol sequences.
+ *
+ * All bits of a sequence are set within a single block of 512 bits, so that a membership query touches only one cache
+ * line. The filter never reports an inserted sequence as missing, but reports a missing sequence as contained with
+ * roughly the configured false positive rate.
+ */
+class BloomFilter {
+ public:
+  /**
+   * Construct an empty bloom filter.
+   * @param n_sequences Expected number of sequences to be inserted.
+   * @param false_positive_rate Targeted probability of reporting a missing sequence as contained.
+   */
+  BloomFilter(size_t n_sequences, float false_positive_rate);
+
+  /**
+   * Insert a symbol sequence into the filter.
+   * @param sequence Corpus symbol sequence.
+   */
+  void
+  insert(t9_symbol_id_view sequence);
+
+  /**
+   * Check whether a symbol sequence might have been inserted into the filter.
+   * @param sequence Corpus symbol sequence.
+   * @return false if the sequence was definitely not inserted. Otherwise true.
+   */
+  bool
+  might_contain(t9_symbol_id_view sequence) const;
+
+  /**
+   * Get the number of bytes occupied by the filter.
+   * @return Size of the filter in bytes.
+   */
+  size_t
+  memory_usage() const;
+
+ protected:
+  /**
+   * Hash a symbol sequence.
+   * @param sequence Corpus symbol sequence.
+   * @return 64 bit hash of the sequence.
+   */
+  static uint64_t
+  hash(t9_symbol_id_view sequence);
+
+  // Bits of all blocks.
+  std::vector<uint64_t> bits;
+
+  // Number of blocks.
+  size_t n_blocks;
+
+  // Number of bits set per sequence.
+  size_t n_hashes;
+};
+
+/**
+ * Language model decorator answering lookups of unseen sequences from a bloom filter.
+ *
+ * The filter holds every sequence stored in the wrapped frozen corpus tree. Lookups the filter rejects return the
+ * unseen cost without descending the tree, all others are forwarded to the tree. The decorator counts its lookups to
+ * report how effective the filter is. The counters are not synchronized.
+ */
+class BloomFilteredModel : public LanguageModel {
+ public:
+  /**
+   * Wrap a frozen corpus tree. The decorator takes ownership of the tree.
+   * @param tree Frozen corpus tree.
+   * @param false_positive_rate Targeted probability of forwarding a lookup of an unseen sequence to the tree.
+   */
+  BloomFilteredModel(const FrozenCorpusTree *tree, float false_positive_rate);
+
+  /**
+   * Destruct the decorator and the wrapped tree.
+   */
+  ~BloomFilteredModel() override;
+
+  BloomFilteredModel(const BloomFilteredModel &) = delete;
+  BloomFilteredModel &operator=(const BloomFilteredModel &) = delete;
+
+  float
+  conditional_probability(t9_symbol_id_view sequence) const override;
+
+  float
+  conditional_cost(t9_symbol_id_view sequence) const override;
+
+  void
+  conditional_costs(t9_symbol_id_view context, std::vector<float> &costs) const override;
+
+  void
+  conditional_cost_batch(const std::vector<t9_symbol_id_view> &sequences, std::vector<float> &costs) const override;
+
+  size_t
+  memory_usage() const override;
+
+  /**
+   * Get the number of bytes occupied by the bloom filter alone.
+   * @return Size of the filter in bytes.
+   */
+  size_t
+  filter_memory_usage() const;
+
+  /**
+   * Get the number of lookups checked against the filter.
+   * @return Number of lookups.
+   */
+  size_t
+  n_lookups() const;
+
+  /**
+   * Get the share of lookups that were answered by the filter alone.
+   * @return Number of rejected lookups divided by the number of lookups.
+   */
+  float
+  hit_rate() const;
+
+  /**
+   * Get the observed share of lookups of unseen sequences that the filter did not reject.
+   * @return Number of false positives divided by the number of lookups of unseen sequences.
+   */
+  float
+  false_positive_rate() const;
+
+ protected:
+  /**
+   * Check a lookup against the filter and count it.
+   * @param sequence Corpus symbol sequence.
+   * @return false if the sequence is definitely not stored in the tree. Otherwise true.
+   */
+  bool
+  check(t9_symbol_id_view sequence) const;
+
+  // Wrapped frozen corpus tree.
+  const FrozenCorpusTree *tree;
+
+  // Filter holding all sequences stored in the tree.
+  BloomFilter filter;
+
+  // Lookup statistics.
+  mutable size_t n_checked;
+  mutable size_t n_rejected;
+  mutable size_t n_false_positives;
+};
+
+}  // namespace t9
+
+#endif //CPP_T9_BLOOM_HPP
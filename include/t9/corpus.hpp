@@ -9,11 +9,14 @@
 #ifndef CPP_T9_CORPUS_HPP
 #define CPP_T9_CORPUS_HPP
 
+#include <array>
+#include <bitset>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <string>
 #include <unordered_map>
-#include <unordered_set>
+#include <vector>
 #include <iterator>
 
 #include "format.hpp"
@@ -45,10 +48,13 @@ class Corpus {
    * @param test_file_path Path to a text file containing the test data.
    * @param n_test Number of bytes to load from the test file.
    * @param keyboard map defining the mapping between T9 keyboard keys and the corresponding corpus symbols.
+   * @param train_chunk_size If 0, the train data is loaded into memory. Otherwise the train data is not loaded but
+   * streamed from disk in chunks of this many bytes whenever a model is trained.
    */
   Corpus(const std::filesystem::path &train_file_path, size_t n_train,
          const std::filesystem::path &test_file_path, size_t n_test,
-         const std::unordered_map<t9_symbol, t9_symbol_sequence> &keyboard);
+         const std::unordered_map<t9_symbol, t9_symbol_sequence> &keyboard,
+         size_t train_chunk_size = 0);
 
   /***
    * Get a sequence of all the corpus symbols that are assigned to a key.
@@ -82,6 +88,98 @@ class Corpus {
   bool
   validate_corpus_symbols(const t9_symbol_sequence &symbols) const;
 
+  /***
+   * Get the identifier of a T9 key.
+   * @param key T9 keyboard key.
+   * @return Key identifier or T9_INVALID_SYMBOL_ID if the key is unknown.
+   */
+  inline t9_symbol_id
+  key_id(t9_symbol key) const {
+    return key_ids[static_cast<unsigned char>(key)];
+  }
+
+  /***
+   * Get the identifier of a corpus symbol.
+   * @param corpus_symbol Corpus symbol.
+   * @return Symbol identifier or T9_INVALID_SYMBOL_ID if the symbol is unknown.
+   */
+  inline t9_symbol_id
+  symbol_id(t9_symbol corpus_symbol) const {
+    return symbol_ids[static_cast<unsigned char>(corpus_symbol)];
+  }
+
+  /***
+   * Get the T9 key belonging to a key identifier.
+   * @param id Key identifier.
+   * @return T9 keyboard key.
+   */
+  inline t9_symbol
+  key(t9_symbol_id id) const {
+    return id_keys[id];
+  }
+
+  /***
+   * Get the corpus symbol belonging to a symbol identifier.
+   * @param id Symbol identifier.
+   * @return Corpus symbol.
+   */
+  inline t9_symbol
+  symbol(t9_symbol_id id) const {
+    return id_symbols[id];
+  }
+
+  /***
+   * Get the identifier of the key a corpus symbol is assigned to.
+   * @param id Symbol identifier.
+   * @return Key identifier.
+   */
+  inline t9_symbol_id
+  key_of_symbol(t9_symbol_id id) const {
+    return symbol_keys[id];
+  }
+
+  /***
+   * Get the number of distinct T9 keys.
+   * @return Number of key identifiers.
+   */
+  inline size_t
+  n_keys() const {
+    return id_keys.size();
+  }
+
+  /***
+   * Get the number of distinct corpus symbols.
+   * @return Number of symbol identifiers.
+   */
+  inline size_t
+  n_symbols() const {
+    return id_symbols.size();
+  }
+
+  /***
+   * Convert a sequence of T9 keys into key identifiers.
+   * @param keys Sequence of valid T9 keys.
+   * @return Sequence of key identifiers.
+   */
+  t9_symbol_id_sequence
+  encode_keys(const t9_symbol_sequence &keys) const;
+
+  /***
+   * Convert a sequence of corpus symbols into symbol identifiers.
+   * @param symbols Sequence of valid corpus symbols.
+   * @return Sequence of symbol identifiers.
+   */
+  t9_symbol_id_sequence
+  encode_symbols(const t9_symbol_sequence &symbols) const;
+
+  /***
+   * Convert a sequence of symbol identifiers back into corpus symbols.
+   * @param ids Sequence of symbol identifiers.
+   * @return Sequence of corpus symbols.
+   */
+  t9_symbol_sequence
+  decode_symbols(t9_symbol_id_view ids) const;
+
   /***
    * Count element wise how many symbols in two sequences are differing.
    * Both sequences are required to have the same length.
@@ -101,13 +199,44 @@ class Corpus {
   t9_symbol_sequence
   keys_from_corpus(const t9_symbol_sequence &corpus_sequence) const;
 
+  /**
+   * Check if the train data is streamed from disk instead of being held in memory.
+   * @return true if the train data is streamed, false otherwise.
+   */
+  bool
+  is_streamed() const;
+
+  /**
+   * Get the number of train symbols, without streaming the train data.
+   * @return Length of the train data.
+   */
+  size_t
+  train_length() const;
+
+  /**
+   * Pass the train data to a consumer in consecutive chunks.
+   * Each chunk is prefixed with the last `overlap` symbols of the previous one. With an overlap of `ngram_length - 1`,
+   * every ngram of the train data starts in exactly one chunk. Train data held in memory is passed as a single chunk.
+   * @param overlap Number of symbols carried over from one chunk to the next.
+   * @param consumer Function called for each chunk of corpus symbol identifiers.
+   */
+  void
+  stream_train_data(size_t overlap, const std::function<void(t9_symbol_id_view)> &consumer) const;
+
   /**
    * Get the train data.
-   * @return Sequence of corpus symbols for training.
+   * @return Sequence of corpus symbol identifiers for training. Empty if the train data is streamed.
    */
-  const t9_symbol_sequence &
+  const t9_symbol_id_sequence &
   get_train_data() const;
 
+  /**
+   * Get the corpus symbols.
+   * @return Sequence of all corpus symbols in the order of their identifiers.
+   */
+  t9_symbol_sequence
+  get_alphabet() const;
+
   /**
    * Get the test data.
    * @return Sequence of corpus symbols for evaluation.
@@ -115,29 +244,34 @@ class Corpus {
   const t9_symbol_sequence &
   get_test_data() const;
 
-  // Set of unique keys found in the key to corpus symbol table.
-  std::unordered_set<t9_symbol> keys_set;
+ private:
+  // Raw symbol to identifier lookup tables. Unknown symbols map to T9_INVALID_SYMBOL_ID.
+  std::array<t9_symbol_id, 256> key_ids;
+  std::array<t9_symbol_id, 256> symbol_ids;
 
-  // Set of unique corpus symbols found in the key to corpus symbol table.
-  std::unordered_set<t9_symbol> corpus_set;
+  // Bitmaps of the valid keys and corpus symbols.
+  std::bitset<256> key_mask;
+  std::bitset<256> symbol_mask;
 
- protected:
-  /***
-   * Populate a set with unique symbols found in a sequence.
-   * @param data Data sequence to construct the set from.
-   * @return A set of thee unique symbols contained.
-   */
-  std::unordered_set<t9_symbol>
-  construct_set_from_sequence(const t9_symbol_sequence &data);
+  // Identifier to raw symbol lookup tables.
+  std::vector<t9_symbol> id_keys;
+  std::vector<t9_symbol> id_symbols;
 
- private:
-  std::unordered_map<t9_symbol, t9_symbol_sequence> key_2_corpus_map;
-  std::unordered_map<t9_symbol, t9_symbol> corpus_2_key_map;
+  // Key identifier each corpus symbol is assigned to (indexed by symbol identifier).
+  std::vector<t9_symbol_id> symbol_keys;
 
-  // Training data.
-  t9_symbol_sequence train_data;
+  // Corpus symbols assigned to each key (indexed by key identifier).
+  std::vector<t9_symbol_sequence> key_symbols;
 
   // Training data.
+  t9_symbol_id_sequence train_data;
+
+  // Location of the training data and the chunk size used for streaming it.
+  std::filesystem::path train_file_path;
+  size_t n_train;
+  size_t train_chunk_size;
+
+  // Test data.
   t9_symbol_sequence test_data;
 };
 }  // namespace t9
@@ -0,0 +1,82 @@
+// T9 dense ngram table -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#ifndef CPP_T9_DENSE_HPP
+#define CPP_T9_DENSE_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "t9/symbols.hpp"
+#include "t9/corpus.hpp"
+#include "t9/language_model.hpp"
+
+// Maximal number of ngrams a dense table can count. The counts are stored in 32 bits during construction.
+#define T9_DENSE_MAX_NGRAMS 0xFFFFFFFFu
+
+namespace t9 {
+
+/**
+ * Ngram model stored in a dense array indexed by symbol identifier tuples.
+ *
+ * The table holds one cost for every possible sequence of 1 up to the ngram length symbols, including the unseen ones.
+ * Sequences of the same length are stored next to each other, ordered like numbers of base n_symbols. A lookup is
+ * therefore a few multiplications and a single load. As the table grows with n_symbols^ngram_length, it is only
+ * suitable for small ngram lengths.
+ */
+class DenseNGRAMTable : public LanguageModel {
+ public:
+  /**
+   * Count all ngrams of a corpus into a dense table and calculate their costs.
+   * The counts are stored in the table itself, hence the train data may hold at most `T9_DENSE_MAX_NGRAMS` ngrams.
+   * @param corpus Corpus to be used for ngram generation.
+   * @param ngram_length Length of the ngrams to be generated.
+   */
+  DenseNGRAMTable(const Corpus &corpus, size_t ngram_length);
+
+  float
+  conditional_probability(t9_symbol_id_view sequence) const override;
+
+  float
+  conditional_cost(t9_symbol_id_view sequence) const override;
+
+  void
+  conditional_costs(t9_symbol_id_view context, std::vector<float> &costs) const override;
+
+  size_t
+  memory_usage() const override;
+
+  /**
+   * Get the number of bytes a dense table would occupy.
+   * @param n_symbols Number of corpus symbols.
+   * @param ngram_length Length of the longest stored sequences.
+   * @return Size of the table in bytes. The maximal value of size_t if the size can not be represented.
+   */
+  static size_t
+  required_memory(size_t n_symbols, size_t ngram_length);
+
+ protected:
+  // Cost of every sequence, unseen sequences hold the unseen cost.
+  std::vector<float> costs;
+
+  // Index of the first sequence of each length.
+  std::vector<size_t> offsets;
+
+  // Number of corpus symbols.
+  size_t n_symbols;
+
+  // Length of the longest stored sequences.
+  size_t ngram_length;
+
+  // Cost assigned to unknown sequences.
+  float unseen_cost;
+};
+
+}  // namespace t9
+
+#endif //CPP_T9_DENSE_HPP
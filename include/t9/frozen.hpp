@@ -0,0 +1,270 @@
+// T9 frozen corpus tree -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#ifndef CPP_T9_FROZEN_HPP
+#define CPP_T9_FROZEN_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace t9 {
+class CorpusTree;
+class CountSnapshot;
+}  // namespace t9
+
+#include "t9/symbols.hpp"
+#include "t9/io.hpp"
+#include "t9/language_model.hpp"
+
+// Magic bytes and format version identifying a frozen corpus tree file.
+#define T9_MODEL_FILE_MAGIC "T9MODEL"
+#define T9_MODEL_FILE_VERSION 2
+
+namespace t9 {
+
+/**
+ * Immutable, read-only representation of a trained corpus tree.
+ *
+ * The nodes are stored in level order (breadth first) in a set of contiguous arrays. The children of a node are
+ * placed next to each other and are sorted by their symbol. Node 0 is the root node.
+ *
+ * All arrays live in a single buffer that uses the same layout as the binary model file. A tree can therefore either
+ * own its buffer or serve lookups directly from a read-only memory mapping of a model file.
+ */
+class FrozenCorpusTree : public LanguageModel {
+ public:
+  /**
+   * Freeze a trained corpus tree.
+   * @param tree Corpus tree whose probabilities have already been calculated.
+   * @param alphabet Corpus symbols in the order of their identifiers.
+   */
+  FrozenCorpusTree(const CorpusTree &tree, const t9_symbol_sequence &alphabet);
+
+  /**
+   * Freeze the counts of a count snapshot without building a corpus tree first.
+   * The sorted records visit the nodes in the order of a depth first search. The records are read twice, first to count
+   * the nodes of each level and then to write the nodes into the level ordered arrays in place. Apart from the buffer,
+   * only the path to the current ngram is held in memory.
+   * @param snapshot Snapshot whose records are read from the beginning.
+   */
+  explicit FrozenCorpusTree(CountSnapshot &snapshot);
+
+  /**
+   * Open a frozen corpus tree from a binary model file.
+   * The file is memory mapped and queried in place, without parsing or copying the node arrays.
+   * @param file_path Path to a model file written by `save()`.
+   */
+  explicit FrozenCorpusTree(const std::filesystem::path &file_path);
+
+  FrozenCorpusTree(const FrozenCorpusTree &) = delete;
+  FrozenCorpusTree &operator=(const FrozenCorpusTree &) = delete;
+
+  /**
+   * Write the tree to a binary model file.
+   * @param file_path Path of the file to be written.
+   */
+  void
+  save(const std::filesystem::path &file_path) const;
+
+  /**
+   * Convert the frozen tree back into a (mutable) corpus tree holding the same counts.
+   * @param tree Empty corpus tree to populate.
+   */
+  void
+  thaw(CorpusTree &tree) const;
+
+  /**
+   * Calculate the probability of a symbol sequence in the frozen tree.
+   * @param sequence Corpus symbol sequence whose probability should be calculated.
+   * @return Probability of the sequence if the sequence was found in the tree. Otherwise 0.0.
+   */
+  float
+  conditional_probability(t9_symbol_id_view sequence) const override;
+
+  /**
+   * Get the cost of a symbol sequence in the frozen tree.
+   * The cost is the precomputed negative logarithm of the conditional probability of the sequence.
+   * @param sequence Corpus symbol sequence whose cost should be calculated.
+   * @return Cost of the sequence if the sequence was found in the tree. Otherwise the cost of an unseen sequence.
+   */
+  float
+  conditional_cost(t9_symbol_id_view sequence) const override;
+
+  /**
+   * Get the costs of all symbols following a context in the frozen tree.
+   * The context is descended once, afterwards the costs are read from the children of the context node.
+   * @param context Corpus symbol sequence preceding the symbols.
+   * @param costs Collection of costs indexed by the corpus symbol identifier.
+   */
+  void
+  conditional_costs(t9_symbol_id_view context, std::vector<float> &costs) const override;
+
+  /**
+   * Get the costs of many symbol sequences in the frozen tree at once.
+   * All lookups descend the tree level by level in lockstep. The node arrays a lookup reads in its next step are
+   * prefetched one step ahead, hence the cache misses of independent lookups overlap instead of adding up.
+   * @param sequences Corpus symbol sequences whose costs should be calculated.
+   * @param costs Collection the costs are written to, in the order of the sequences.
+   */
+  void
+  conditional_cost_batch(const std::vector<t9_symbol_id_view> &sequences, std::vector<float> &costs) const override;
+
+  /**
+   * Get the cost assigned to sequences that are not contained in the tree.
+   * @return Cost of an unseen sequence.
+   */
+  float
+  unseen_cost() const;
+
+  /**
+   * Get the number of nodes in the tree (including the root node).
+   * @return Number of nodes.
+   */
+  size_t
+  size() const;
+
+  /**
+   * Get the number of bytes occupied by the node arrays.
+   * @return Size of the node arrays in bytes.
+   */
+  size_t
+  memory_usage() const override;
+
+  /**
+   * Get the length of the longest symbol sequence stored in the tree.
+   * @return Depth of the tree.
+   */
+  size_t
+  depth() const;
+
+  /**
+   * Get the corpus symbols the tree was trained with.
+   * @return Corpus symbols in the order of their identifiers.
+   */
+  t9_symbol_sequence
+  alphabet() const;
+
+  /**
+   * Get the size of the buffer a frozen tree with a given number of nodes occupies.
+   * @param n_nodes Number of nodes (including the root node).
+   * @return Size of the buffer in bytes.
+   */
+  static size_t
+  buffer_size(size_t n_nodes);
+
+ protected:
+  friend class QuantizedCorpusTree;
+  friend class BloomFilteredModel;
+
+  /**
+   * Layout of the header at the beginning of the tree buffer.
+   * All offsets are relative to the beginning of the buffer, which keeps the format position independent.
+   */
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t size;
+    uint64_t n_nodes;
+    uint64_t depth;
+    uint64_t n_symbols;
+    t9_symbol alphabet[256];
+    float unseen_cost;
+    uint32_t reserved;
+    uint64_t symbols_offset;
+    uint64_t probabilities_offset;
+    uint64_t costs_offset;
+    uint64_t counts_offset;
+    uint64_t first_child_offset;
+  };
+
+  /**
+   * Calculate the offsets of the node arrays and the size of a buffer.
+   * @param layout Header whose offsets and size are set.
+   * @param n_nodes Number of nodes (including the root node).
+   */
+  static void
+  layout_buffer(Header &layout, size_t n_nodes);
+
+  /**
+   * Allocate an owned, zeroed buffer and write its header.
+   * @param n_nodes Number of nodes (including the root node).
+   * @param tree_depth Length of the longest symbol sequence stored in the tree.
+   * @param alphabet Corpus symbols in the order of their identifiers.
+   * @return Header at the beginning of the buffer, describing the location of the node arrays.
+   */
+  Header &
+  allocate(size_t n_nodes, size_t tree_depth, const t9_symbol_sequence &alphabet);
+
+  /**
+   * Pack the node arrays into an owned buffer. The cost of each node is derived from its probability.
+   * @param node_symbols Corpus symbol identifier of each node.
+   * @param node_probabilities Conditional probability of each node.
+   * @param node_counts Number of occurrences of each node.
+   * @param node_first_child Index of the first child of each node, terminated with a sentinel.
+   * @param tree_depth Length of the longest symbol sequence stored in the tree.
+   * @param alphabet Corpus symbols in the order of their identifiers.
+   */
+  void
+  pack(const std::vector<t9_symbol_id> &node_symbols,
+       const std::vector<float> &node_probabilities,
+       const std::vector<uint64_t> &node_counts,
+       const std::vector<uint32_t> &node_first_child,
+       size_t tree_depth,
+       const t9_symbol_sequence &alphabet);
+
+  /**
+   * Validate a tree buffer and point the node arrays into it.
+   * @param data Beginning of the buffer.
+   * @param size Size of the buffer in bytes.
+   */
+  void
+  bind(const uint8_t *data, size_t size);
+
+  /**
+   * Search a child with a given symbol within the children of a node.
+   * @param node Index of the parent node.
+   * @param symbol Corpus symbol identifier.
+   * @return Index of the child node if it exists. Otherwise 0 (the root node is never a child).
+   */
+  uint32_t
+  find_child(uint32_t node, t9_symbol_id symbol) const;
+
+  // Buffer holding the tree if it was frozen in memory.
+  std::vector<uint8_t> storage;
+
+  // Memory mapping holding the tree if it was opened from a file.
+  std::unique_ptr<io::MappedFile> mapping;
+
+  // Header of the bound buffer.
+  const Header *header;
+
+  // Number of nodes in the tree.
+  size_t n_nodes;
+
+  // Corpus symbol identifier of each node.
+  const t9_symbol_id *symbols;
+
+  // Conditional probability of each node.
+  const float *probabilities;
+
+  // Negative logarithm of the conditional probability of each node.
+  const float *costs;
+
+  // Number of occurrences of each node.
+  const uint64_t *counts;
+
+  // Index of the first child of each node. The children of node i are [first_child[i], first_child[i + 1]).
+  const uint32_t *first_child;
+};
+
+}  // namespace t9
+
+#endif //CPP_T9_FROZEN_HPP
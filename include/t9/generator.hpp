@@ -25,6 +25,41 @@ class NGRAMGenerator {
    */
   NGRAMGenerator(const Corpus &corpus, size_t ngram_length);
 
+  /**
+   * Construct a ngram generator over a range of the training portion of the corpus.
+   * @param corpus Corpus object to generate ngrams from.
+   * @param ngram_length Length of the ngrams to be generated.
+   * @param begin Position of the first ngram to generate.
+   * @param end Position one past the last ngram to generate.
+   * @note Ngrams starting inside of the range may extend up to `ngram_length - 1` symbols beyond its end.
+   */
+  NGRAMGenerator(const Corpus &corpus, size_t ngram_length, size_t begin, size_t end);
+
+  /**
+   * Construct a ngram generator over an arbitrary sequence of corpus symbol identifiers.
+   * @param data Sequence to generate ngrams from. It has to outlive the generator.
+   * @param ngram_length Length of the ngrams to be generated.
+   */
+  NGRAMGenerator(t9_symbol_id_view data, size_t ngram_length);
+
+  /**
+   * Get the total number of ngrams contained in the training portion of a corpus.
+   * @param corpus Corpus object to generate ngrams from.
+   * @param ngram_length Length of the ngrams to be generated.
+   * @return Number of ngrams.
+   */
+  static size_t
+  count_ngrams(const Corpus &corpus, size_t ngram_length);
+
+  /**
+   * Get the total number of ngrams contained in a sequence.
+   * @param data Sequence to generate ngrams from.
+   * @param ngram_length Length of the ngrams to be generated.
+   * @return Number of ngrams.
+   */
+  static size_t
+  count_ngrams(t9_symbol_id_view data, size_t ngram_length);
+
   /**
    * Check if the generator is finished.
    * @return true if the generator is finished, false if there are still ngrams available.
@@ -33,17 +68,17 @@ class NGRAMGenerator {
   is_done() const;
 
   /**
-   * Generate a ngram from the corpus train portion.
+   * Generate the next ngram.
    * @return ngram.
    */
-  std::string_view
+  t9_symbol_id_view
   generate_ngram();
 
  protected:
-  const Corpus &corpus;
+  t9_symbol_id_view data;
   size_t ngram_length;
-  t9_symbol_sequence::const_iterator corpus_iterator;
-  t9_symbol_sequence::const_iterator corpus_iterator_end;
+  size_t position;
+  size_t position_end;
 };
 }  // namespace t9
 
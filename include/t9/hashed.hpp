@@ -0,0 +1,116 @@
+// T9 hashed ngram table -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#ifndef CPP_T9_HASHED_HPP
+#define CPP_T9_HASHED_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "t9/symbols.hpp"
+#include "t9/corpus.hpp"
+#include "t9/language_model.hpp"
+
+// Maximal ngram length that can be packed into a single table key.
+#define T9_HASHED_MAX_NGRAM_LENGTH 8
+
+namespace t9 {
+
+/**
+ * Ngram model stored in a flat open addressing hash table.
+ *
+ * Every prefix of every train ngram (orders 1 up to the ngram length) is packed into a 64 bit key holding one byte per
+ * symbol. A lookup therefore costs one hash and one linear probe sequence instead of a walk down the tree.
+ */
+class HashedNGRAMTable : public LanguageModel {
+ public:
+  /**
+   * Count all ngrams of a corpus into a hash table and calculate their conditional probabilities.
+   * @param corpus Corpus to be used for ngram generation.
+   * @param ngram_length Length of the ngrams to be generated.
+   */
+  HashedNGRAMTable(const Corpus &corpus, size_t ngram_length);
+
+  float
+  conditional_probability(t9_symbol_id_view sequence) const override;
+
+  float
+  conditional_cost(t9_symbol_id_view sequence) const override;
+
+  void
+  conditional_costs(t9_symbol_id_view context, std::vector<float> &costs) const override;
+
+  size_t
+  memory_usage() const override;
+
+  /**
+   * Get the number of ngrams (of all orders) stored in the table.
+   * @return Number of occupied slots.
+   */
+  size_t
+  size() const;
+
+ protected:
+  // Slot of the hash table. Empty slots have a key of 0.
+  struct Slot {
+    uint64_t key;
+    float probability;
+    float cost;
+  };
+
+  /**
+   * Pack a symbol sequence into a table key.
+   * @param sequence Symbol sequence of at most T9_HASHED_MAX_NGRAM_LENGTH symbols.
+   * @return Key of the sequence.
+   */
+  static uint64_t
+  pack(t9_symbol_id_view sequence);
+
+  /**
+   * Find the slot of a key.
+   * @param key Key to search for.
+   * @return Index of the slot holding the key or of the empty slot terminating its probe sequence.
+   */
+  size_t
+  find_slot(uint64_t key) const;
+
+  /**
+   * Increment the count of a key, inserting it if required.
+   * @param key Key to count.
+   */
+  void
+  increment(uint64_t key);
+
+  /**
+   * Double the capacity of the table and reinsert all keys.
+   */
+  void
+  grow();
+
+  // Open addressing table, its capacity is a power of two.
+  std::vector<Slot> slots;
+
+  // Number of occurrences of the key in each slot, only held during construction.
+  std::vector<uint64_t> counts;
+
+  // Number of occupied slots.
+  size_t n_entries;
+
+  // Number of bits used to index the table.
+  unsigned int index_bits;
+
+  // Length of the longest stored ngrams.
+  size_t ngram_length;
+
+  // Cost assigned to unknown sequences.
+  float unseen_cost;
+};
+
+}  // namespace t9
+
+#endif //CPP_T9_HASHED_HPP
@@ -9,6 +9,7 @@
 #ifndef CPP_T9_IO_HPP
 #define CPP_T9_IO_HPP
 
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
@@ -26,6 +27,88 @@ namespace t9::io {
 std::string
 load_text_file(const std::filesystem::path &file_path,
                size_t n_chars);
+
+/***
+ * Sequential reader loading a text file in chunks of bounded size.
+ */
+class TextFileReader {
+ public:
+  /***
+   * Open a text file for reading.
+   * @param file_path Path to the file to be read.
+   * @param n_chars Maximal number of bytes to be read. If 0 is supplied, the whole file will be read.
+   */
+  TextFileReader(const std::filesystem::path &file_path, size_t n_chars);
+
+  /***
+   * Check if the whole file (or the requested number of bytes) was read.
+   * @return true if there is no more data to read, false otherwise.
+   */
+  bool
+  is_done() const;
+
+  /***
+   * Read the next chunk of the file.
+   * @param chunk Buffer the chunk is written to. Its previous content is replaced.
+   * @param chunk_size Maximal number of bytes to read.
+   */
+  void
+  read_chunk(std::string &chunk, size_t chunk_size);
+
+ protected:
+  std::ifstream file;
+  size_t remaining;
+};
+
+/***
+ * Write a block of memory to a binary file. An existing file is replaced.
+ * @param file_path Path to the file to be written.
+ * @param data Beginning of the memory block.
+ * @param size Size of the memory block in bytes.
+ */
+void
+save_binary_file(const std::filesystem::path &file_path,
+                 const void *data,
+                 size_t size);
+
+/***
+ * Read-only memory mapping of a whole file.
+ * The mapping is shared, hence processes mapping the same file share a single copy in the page cache.
+ */
+class MappedFile {
+ public:
+  /***
+   * Map a file into memory.
+   * @param file_path Path to the file to be mapped.
+   */
+  explicit MappedFile(const std::filesystem::path &file_path);
+
+  /***
+   * Unmap the file.
+   */
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  /***
+   * Get the beginning of the mapped memory.
+   * @return Pointer to the first byte of the file.
+   */
+  const uint8_t *
+  data() const;
+
+  /***
+   * Get the size of the mapped memory.
+   * @return Size of the file in bytes.
+   */
+  size_t
+  size() const;
+
+ protected:
+  void *address;
+  size_t length;
+};
 }  // namespace t9::io
 
 #endif //CPP_T9_IO_HPP
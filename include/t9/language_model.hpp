@@ -0,0 +1,88 @@
+// T9 language model interface -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#ifndef CPP_T9_LANGUAGE_MODEL_HPP
+#define CPP_T9_LANGUAGE_MODEL_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "t9/symbols.hpp"
+
+namespace t9 {
+
+/**
+ * Common interface of all trained ngram models the search can be served from.
+ *
+ * A sequence s of length k is looked up as the conditional probability P(s[k-1] | s[0..k-2]) that was estimated from
+ * all ngrams of the training data starting with s.
+ */
+class LanguageModel {
+ public:
+  virtual ~LanguageModel() = default;
+
+  /**
+   * Calculate the conditional probability of a symbol sequence.
+   * @param sequence Corpus symbol sequence whose probability should be calculated.
+   * @return Probability of the sequence if the sequence is known. Otherwise 0.0.
+   */
+  virtual float
+  conditional_probability(t9_symbol_id_view sequence) const = 0;
+
+  /**
+   * Get the cost of a symbol sequence, the negative logarithm of its conditional probability.
+   * @param sequence Corpus symbol sequence whose cost should be calculated.
+   * @return Cost of the sequence if the sequence is known. Otherwise the cost of an unseen sequence.
+   */
+  virtual float
+  conditional_cost(t9_symbol_id_view sequence) const = 0;
+
+  /**
+   * Get the costs of all symbols following a context.
+   * Models override this to look the context up once instead of once per symbol.
+   * @param context Corpus symbol sequence preceding the symbols.
+   * @param costs Collection of costs indexed by the corpus symbol identifier. Entry i is set to the cost of the context
+   * followed by symbol i. Its size determines the number of symbols.
+   */
+  virtual void
+  conditional_costs(t9_symbol_id_view context, std::vector<float> &costs) const {
+    t9_symbol_id_sequence sequence(context);
+    sequence.push_back(0);
+
+    for (size_t symbol = 0; symbol < costs.size(); symbol++) {
+      sequence.back() = static_cast<t9_symbol_id>(symbol);
+      costs[symbol] = conditional_cost(sequence);
+    }
+  }
+
+  /**
+   * Get the costs of many symbol sequences at once.
+   * Models override this to interleave the independent lookups, so that their memory accesses overlap.
+   * @param sequences Corpus symbol sequences whose costs should be calculated.
+   * @param costs Collection the costs are written to, in the order of the sequences.
+   */
+  virtual void
+  conditional_cost_batch(const std::vector<t9_symbol_id_view> &sequences, std::vector<float> &costs) const {
+    costs.resize(sequences.size());
+
+    for (size_t index = 0; index < sequences.size(); index++) {
+      costs[index] = conditional_cost(sequences[index]);
+    }
+  }
+
+  /**
+   * Get the number of bytes occupied by the model.
+   * @return Size of the model in bytes.
+   */
+  virtual size_t
+  memory_usage() const = 0;
+};
+
+}  // namespace t9
+
+#endif //CPP_T9_LANGUAGE_MODEL_HPP
@@ -13,26 +13,130 @@
 
 namespace t9 {
 class SearchTree;
-class CorpusTree;
+class LanguageModel;
 }  // namespace t9
 
 #include <vector>
+#include <unordered_map>
 #include <utility>
 
 #include "t9/symbols.hpp"
 #include "t9/corpus.hpp"
 #include "t9/tree.hpp"
+#include "t9/beam.hpp"
+#include "t9/frozen.hpp"
+#include "t9/hashed.hpp"
+#include "t9/dense.hpp"
+#include "t9/sketch.hpp"
+#include "t9/suffix.hpp"
+#include "t9/snapshot.hpp"
+#include "t9/quantized.hpp"
+#include "t9/bloom.hpp"
+#include "t9/language_model.hpp"
 
 namespace t9 {
+/**
+ * Data structures a model can be served from.
+ */
+enum class ModelBackend {
+  // Frozen corpus tree with level ordered node arrays.
+  TRIE,
+  // Open addressing hash table of packed ngrams.
+  HASHED,
+  // Dense table holding the costs of all possible sequences.
+  DENSE,
+  // Dense table if it fits into the memory budget of the options, frozen corpus tree otherwise.
+  AUTO,
+  // Count-min sketch of fixed size holding approximate counts.
+  SKETCH,
+};
+
+/**
+ * Implementations of the search for the best suggestions. Both find the same suggestions.
+ */
+enum class SearchDecoder {
+  // Flat arrays of hypotheses, expanded in a single pass per key.
+  BEAM,
+  // Tree of search nodes, expanded, searched and pruned recursively.
+  TREE,
+};
+
+/**
+ * Optional parameters controlling how a model is built.
+ */
+struct ModelOptions {
+  // Number of threads used to count the train ngrams. A value of 1 builds the corpus tree serially.
+  size_t n_threads = 1;
+
+  // Data structure the trained model is stored in.
+  ModelBackend backend = ModelBackend::TRIE;
+
+  // Maximal size of a dense table in bytes for the automatic backend selection.
+  size_t dense_max_bytes = 16 * 1024 * 1024;
+
+  // Size of the counters of the count-min sketch in bytes.
+  size_t sketch_max_bytes = 16 * 1024 * 1024;
+
+  // Number of rows of counters of the count-min sketch.
+  size_t sketch_depth = 4;
+
+  // Implementation of the search for the best suggestions.
+  SearchDecoder decoder = SearchDecoder::BEAM;
+
+  // Maximal number of best paths ending in the same (ngram_length - 1) symbols the beam decoder keeps. Such paths are
+  // scored identically from then on, 1 keeps only the best of them. A value of 0 does not recombine paths.
+  size_t paths_per_state = 0;
+
+  // Probability of pressing the key a symbol is assigned to when typing the symbol.
+  float key_probability = PROBABILITY_BUTTON;
+
+  // Keys that are likely to be pressed by mistake instead of a key, e.g. physically adjacent keys. Maps a T9 key to
+  // the sequence of its neighbour keys.
+  std::unordered_map<t9_symbol, t9_symbol_sequence> neighbour_keys;
+
+  // Probability of pressing a neighbour key of the key a symbol is assigned to. Pressing any other key has a
+  // probability of `1 - key_probability`.
+  float neighbour_key_probability = 0.0f;
+};
+
+/**
+ * Parameters controlling how a trained corpus tree is pruned.
+ */
+struct PruneOptions {
+  // Score deciding which branches are removed first.
+  PruneCriterion criterion = PruneCriterion::COUNT;
+
+  // Nodes seen less often are always removed.
+  size_t min_count = 0;
+
+  // Maximal number of nodes to keep. A value of 0 does not limit the number of nodes.
+  size_t max_nodes = 0;
+
+  // Maximal size of the frozen corpus tree in bytes. A value of 0 does not limit the size.
+  size_t max_bytes = 0;
+};
+
+/**
+ * Summary of a pruning pass.
+ */
+struct PruneReport {
+  size_t n_nodes_before;
+  size_t n_nodes_after;
+  size_t n_bytes_before;
+  size_t n_bytes_after;
+};
+
 class Model {
  public:
   /**
    * Construct a T9 model.
    * @param corpus Corpus object to use for model construction, training and validation.
-   * @param ngram_length Length of the ngrams to use for model construction.
+   * @param ngram_length Length of the ngrams to use for model construction. Has to be at least 1.
    * @param n_paths Number of paths/beams to maintain when building the best suggestions.
+   * @param options Optional parameters controlling how the model is built. The key probabilities have to be within
+   * [0, 1], and the key probability plus the neighbour key probability of all neighbours of a key at most 1.
    */
-  Model(const Corpus &corpus, size_t ngram_length, size_t n_paths);
+  Model(const Corpus &corpus, size_t ngram_length, size_t n_paths, const ModelOptions &options = ModelOptions());
 
   /**
    * Destruct the model.
@@ -41,12 +145,99 @@ class Model {
 
   /**
    * Construct a statistical model of the likelihood of occurrence of ngram text sequences.
+   * With the trie backend, the model is trained using a corpus tree which is frozen into a read-only representation
+   * afterwards. The hashed, dense and sketch backends count the ngrams directly into their tables. The automatic
+   * backend picks the dense table if it does not exceed `dense_max_bytes` and the train data holds at most
+   * `T9_DENSE_MAX_NGRAMS` symbols, the trie otherwise.
    */
   void
   build_corpus_tree();
 
   /**
-   * Discard and reinitialize the search tree.
+   * Construct the model from a suffix array instead of counting the ngrams of the train data again.
+   * The same suffix array can be used to build models with different ngram lengths.
+   * @param suffix_array Suffix array over the train data of the corpus of the model.
+   */
+  void
+  build_corpus_tree(const SuffixArray &suffix_array);
+
+  /**
+   * Write the trained corpus tree to a binary model file.
+   * Only models using the trie backend can be saved.
+   * @param file_path Path of the model file to be written.
+   */
+  void
+  save_corpus_tree(const std::filesystem::path &file_path) const;
+
+  /**
+   * Load a corpus tree from a binary model file instead of building it.
+   * The file is memory mapped and queried in place. Processes loading the same file share its pages.
+   * @param file_path Path to a model file written by `save_corpus_tree()`.
+   */
+  void
+  load_corpus_tree(const std::filesystem::path &file_path);
+
+  /**
+   * Count the ngrams of the train data and write them to a count snapshot file instead of building the model.
+   * The train data of the corpus is one shard of the whole train data. The snapshots of all shards are merged with
+   * `CountSnapshot::merge()` and loaded with `load_count_snapshot()`.
+   * @param file_path Path of the snapshot file to be written.
+   */
+  void
+  save_count_snapshot(const std::filesystem::path &file_path) const;
+
+  /**
+   * Build the model from a count snapshot file instead of counting the ngrams of the train data.
+   * @param file_path Path to a snapshot file written by `save_count_snapshot()` or `CountSnapshot::merge()`.
+   */
+  void
+  load_count_snapshot(const std::filesystem::path &file_path);
+
+  /**
+   * Feed additional training text into the model.
+   * Only the counts along the paths of the new ngrams are updated, probabilities are derived from the counts at lookup
+   * time. The first update converts a frozen corpus tree back into a corpus tree, later updates reuse it. Ngrams do
+   * not span across separate updates.
+   * @param text Sequence of corpus symbols.
+   */
+  void
+  update(const t9_symbol_sequence &text);
+
+  /**
+   * Freeze the corpus tree again after a series of updates to speed up lookups.
+   */
+  void
+  freeze_corpus_tree();
+
+  /**
+   * Prune the frozen corpus tree to reduce its size.
+   * Low count or low information branches are removed until the limits of the options are met, the probabilities of
+   * the remaining nodes are renormalized.
+   * @param prune_options Parameters controlling which and how many nodes are removed.
+   * @return Number of nodes and bytes before and after pruning.
+   */
+  PruneReport
+  prune_corpus_tree(const PruneOptions &prune_options);
+
+  /**
+   * Replace the frozen corpus tree with a quantized copy that stores an 8 or 16 bit cost code per node.
+   * @param bits Number of bits per code, either 8 or 16.
+   * @return Largest absolute deviation between a quantized and an original cost.
+   */
+  float
+  quantize_corpus_tree(size_t bits);
+
+  /**
+   * Wrap the frozen corpus tree into a bloom filter that rejects lookups of unseen sequences without descending the
+   * tree. The wrapped model can no longer be saved, updated, pruned or quantized.
+   * @param false_positive_rate Targeted probability of the filter not rejecting a lookup of an unseen sequence.
+   * @return Bloom filtered model, owned by the model.
+   */
+  const BloomFilteredModel *
+  filter_unseen_sequences(float false_positive_rate);
+
+  /**
+   * Discard and reinitialize the search tree or the beam decoder, whichever is used.
    */
   void
   reset_search_tree();
@@ -59,6 +250,20 @@ class Model {
   std::vector<std::pair<t9_symbol_sequence, float>>
   autocomplete(const t9_symbol_sequence &input);
 
+  /**
+   * Get the number of paths maintained when building the best suggestions.
+   * @return Number of paths/beams.
+   */
+  size_t
+  get_n_paths() const;
+
+  /**
+   * Get the options the model was built with.
+   * @return Model options.
+   */
+  const ModelOptions &
+  get_options() const;
+
   /**
    * Evaluate the model based on the corpus test data.
    * @return Evaluation score. Measures the number of element-wise differing characters between the best generated
@@ -69,22 +274,49 @@ class Model {
 
   /**
    * Calculate the conditional probability of `key` being pressed when a corpus symbol `symbol` was seen.
-   * @param key T9 key.
-   * @param symbol Corpus symbol.
+   * @param key T9 key identifier.
+   * @param symbol Corpus symbol identifier.
    * @return Probability P(key | symbol)
    */
   float
-  probability_key_when_symbol(t9_symbol key, t9_symbol symbol) const;
+  probability_key_when_symbol(t9_symbol_id key, t9_symbol_id symbol) const;
+
+  /**
+   * Get the cost of `key` being pressed when a corpus symbol `symbol` was seen.
+   * @param key T9 key identifier.
+   * @param symbol Corpus symbol identifier.
+   * @return Precomputed negative logarithm of P(key | symbol).
+   */
+  inline float
+  cost_key_when_symbol(t9_symbol_id key, t9_symbol_id symbol) const {
+    return emission_costs[key * corpus.n_symbols() + symbol];
+  }
+
+  /**
+   * Get the costs of `key` being pressed for all corpus symbols.
+   * @param key T9 key identifier.
+   * @return Pointer to the precomputed costs -ln(P(key | symbol)), indexed by the corpus symbol identifier.
+   */
+  inline const float *
+  costs_of_key(t9_symbol_id key) const {
+    return emission_costs.data() + key * corpus.n_symbols();
+  }
 
  public:
   // TODO(yweweler): Refactor: Write getter style access functions.
   SearchTree *search_tree;
-  CorpusTree *corpus_tree;
+  BeamDecoder *beam_decoder;
+  LanguageModel *language_model;
   const Corpus &corpus;
   size_t ngram_length;
 
  protected:
   size_t n_paths;
+  ModelOptions options;
+
+  // Cost of pressing each key when typing each symbol, -ln(P(key | symbol)). The costs of a key are stored next to
+  // each other and are indexed by the corpus symbol identifier.
+  std::vector<float> emission_costs;
 };
 }  // namespace t9
 
@@ -9,10 +9,10 @@
 #ifndef CPP_T9_NODE_HPP
 #define CPP_T9_NODE_HPP
 
+#include <array>
 #include <memory>
 #include <vector>
 #include <unordered_set>
-#include <list>
 #include <algorithm>
 #include <experimental/memory>
 
@@ -24,6 +24,12 @@ class SearchPath;
 #include "t9/symbols.hpp"
 #include "t9/path.hpp"
 
+// Number of children whose symbols are searched with a single SIMD comparison.
+#define T9_CORPUS_NODE_SMALL_SIZE 16
+
+// Number of search nodes allocated at once by a search node pool.
+#define T9_SEARCH_NODE_SLAB_SIZE 4096
+
 using std::experimental::observer_ptr;
 using std::experimental::make_observer;
 
@@ -31,9 +37,9 @@ namespace t9 {
 
 class Node {
  public:
-  Node(t9_symbol symbol, float probability);
+  Node(t9_symbol_id symbol, float probability);
 
-  t9_symbol symbol;
+  t9_symbol_id symbol;
   float probability;
 };
 
@@ -41,75 +47,185 @@ class CorpusNode : public Node {
  public:
   /**
    * Construct a corpus tree node.
-   * @param symbol Corpus symbol.
-   * @param probability Probability of this specific node for its the position in the tree.
+   * @param symbol Corpus symbol identifier.
    */
-  CorpusNode(t9_symbol symbol);
+  CorpusNode(t9_symbol_id symbol);
 
   /**
    * Destruct a corpus tree node.
    */
   ~CorpusNode();
 
+  /**
+   * Search a node with a given symbol within the children of a node.
+   * @param symbol Corpus symbol identifier.
+   * @return Pointer to a corpus node if a child with the symbol exists. Otherwise nullptr.
+   */
+  CorpusNode *
+  get_child(t9_symbol_id symbol) const;
+
   /**
    * Search a node with a given symbol within the children of a node.
    * If no child is found, a new child with the searched symbol is created.
-   * @param symbol Corpus symbol.
+   * @param symbol Corpus symbol identifier.
    * @return  Pointer to a corpus node.
    */
   CorpusNode *
-  get_child_safe(t9_symbol symbol);
+  get_child_safe(t9_symbol_id symbol);
+
+  /**
+   * Prefetch what `get_child()` reads outside of the node to find the child with a symbol. The children themselves
+   * are not read.
+   * @param symbol Corpus symbol identifier.
+   */
+  inline void
+  prefetch_child(t9_symbol_id symbol) const {
+    if (child_index) {
+      __builtin_prefetch(child_index.get() + symbol);
+    } else {
+      __builtin_prefetch(children.data());
+    }
+  }
+
+  /**
+   * Delete a child and its subtree.
+   * @param child Child of this node to delete.
+   */
+  void
+  remove_child(CorpusNode *child);
+
+  /**
+   * Get the parent of the node.
+   * @return Pointer to the parent node. nullptr for the root node.
+   */
+  CorpusNode *
+  get_parent() const;
 
   /**
    * Insert a ngram into the corpus tree originating from this node.
    * @param ngram Ngram to insert.
    */
   void
-  insert_ngram(std::string_view ngram);
+  insert_ngram(t9_symbol_id_view ngram);
+
+  /**
+   * Merge the counts of another node and its children into this node.
+   * Children of the other node that do not exist in this node are moved over. The other node is left without children.
+   * @param other Node to merge.
+   */
+  void
+  merge(CorpusNode *other);
 
   /**
    * Calculate probability of a node and it's children.
+   * The counts of the children are normalized by their sum, which equals the count of the node unless children were
+   * pruned. All other lookups normalize by the same sum.
    */
   void
   calculate_probabilities();
 
   /**
    * Calculate the probability of a symbol sequence originating from this node.
+   * The probability is derived from the node counts, hence it is also valid before `calculate_probabilities()` ran.
    * @param sequence Corpus symbol sequence whose probability should be calculated.
    * @return Estimated likelihood of occurrence of the sequence.
    */
   float
-  conditional_probability(std::string_view sequence) const;
+  conditional_probability(t9_symbol_id_view sequence) const;
 
+  /**
+   * Estimate the number of bytes occupied by the node and its children.
+   * @return Size of the subtree in bytes.
+   */
+  size_t
+  memory_usage() const;
+
+  // Collection of children nodes. Children are only added and removed through the member functions of the node, which
+  // keep the child lookup structures in sync.
   std::vector<CorpusNode *> children;
   size_t count;
 
+  // Sum of the counts of the children. Code that changes the count of a child directly has to update it as well.
+  size_t children_count;
+
  protected:
+  /**
+   * Append a child to the collection of children and register it with the child lookup structures.
+   * @param child Child node whose parent is set to this node.
+   */
+  void
+  link_child(CorpusNode *child);
+
+  /**
+   * Rebuild the child lookup structures from the collection of children.
+   */
+  void
+  rebuild_child_index();
+
   observer_ptr<CorpusNode> parent;
+
+  // Symbols of the first children in the order of the collection of children. Nodes with few children are searched
+  // by comparing all of them at once.
+  alignas(16) t9_symbol_id child_symbols[T9_CORPUS_NODE_SMALL_SIZE];
+
+  // Position of the child of each symbol in the collection of children, for nodes with more than
+  // T9_CORPUS_NODE_SMALL_SIZE children. Missing children are marked with T9_INVALID_SYMBOL_ID.
+  std::unique_ptr<uint8_t[]> child_index;
 };
 
+class SearchNodePool;
+class SearchPathHeap;
+
+/**
+ * Node of the search tree.
+ * The children of a node form an intrusive doubly linked list, hence search nodes own no memory and are released
+ * without running a destructor. All search nodes of a tree are allocated from the `SearchNodePool` of the tree.
+ */
 class SearchNode : public Node {
  public:
   /**
    * Construct a search node.
-   * @param symbol Corpus symbol.
+   * @param symbol Corpus symbol identifier.
    * @param probability Probability of the search node.
    */
-  SearchNode(t9_symbol symbol, float probability);
+  SearchNode(t9_symbol_id symbol, float probability);
 
   /**
-   * Destruct the search node.
+   * Type a single symbol into a search tree.
+   * @param symbol Identifier of the T9 key to type.
+   * @param sequence Path up to and including this node. Symbols are appended and removed again while descending.
+   * @param costs Buffer for the costs of all corpus symbols, sized to the number of corpus symbols.
+   * @param pool Pool the new nodes are allocated from.
+   * @param model T9 model used to access all information required to insert the symbol.
    */
-  ~SearchNode();
+  void
+  insert(t9_symbol_id symbol,
+         t9_symbol_id_sequence &sequence,
+         std::vector<float> &costs,
+         SearchNodePool &pool,
+         Model *model);
 
   /**
-   * Type a single symbol into a search tree.
-   * @param symbol T9 key to type.
-   * @param sequence Temporary sequence buffer used by the function to construct ngrams.
+   * Type a single symbol into a search tree, specialized for a fixed ngram length.
+   * The search tree instantiates it for ngram lengths of 2 up to 6 and uses `insert()` for all other lengths.
+   * Only the last (ngram_length - 1) symbols of a path are required to look up the costs of its children. They are kept
+   * in a buffer of fixed size on the stack, which is shifted by one symbol per level instead of copying the whole path.
+   * @tparam ngram_length Length of the ngrams of the model.
+   * @param symbol Identifier of the T9 key to type.
+   * @param context Last symbols of the path up to and including this node, right aligned in the buffer.
+   * @param context_length Number of valid symbols in the context.
+   * @param costs Buffer for the costs of all corpus symbols, sized to the number of corpus symbols.
+   * @param pool Pool the new nodes are allocated from.
    * @param model T9 model used to access all information required to insert the symbol.
    */
+  template<size_t ngram_length>
   void
-  insert(t9_symbol symbol, t9_symbol_sequence &sequence, Model *model);
+  insert_fixed(t9_symbol_id symbol,
+               const std::array<t9_symbol_id, ngram_length - 1> &context,
+               size_t context_length,
+               std::vector<float> &costs,
+               SearchNodePool &pool,
+               Model *model);
 
   /**
    * Check if the node is a leaf node.
@@ -122,26 +238,126 @@ class SearchNode : public Node {
    * Prune the node in case it is not a member of on of the best known paths.
    * @param path Path of nodes through the tree up to the current node.
    * @param best_paths Collection of the best scoring paths in the tree.
+   * @param pool Pool the pruned nodes are returned to.
    */
   void
-  prune(SearchPath &path, std::vector<SearchPath> &best_paths);
+  prune(SearchPath &path, std::vector<SearchPath> &best_paths, SearchNodePool &pool);
 
   /**
-   * Populate the list of best paths in a given model, originating from the node.
-   * @param current_path Current path of nodes that was taken (up and including the current node).
-   * @param best_paths Collection of the best scoring paths in the tree.
-   * @param max_paths maximal number of best scoring paths to keep track of before discarding new ones.
+   * Offer all leaves below the node to the best paths, in depth first order.
+   * Subtrees whose node can not enter the full heap are skipped, as the probabilities (costs) never decrease along a
+   * path.
+   * @param heap Best leaves found so far.
    */
   void
-  search_paths(SearchPath &current_path, std::vector<SearchPath> &best_paths, size_t max_paths);
-
- public:
-  // Collection of children nodes.
-  std::list<SearchNode *> children;
+  search_paths(SearchPathHeap &heap);
 
  protected:
+  friend class SearchNodePool;
+  friend class SearchPathHeap;
+
+  /**
+   * Append a child for each corpus symbol to a leaf node.
+   * @param symbol Identifier of the typed T9 key.
+   * @param context Last (ngram_length - 1) symbols of the path up to and including this node.
+   * @param costs Buffer for the costs of all corpus symbols, sized to the number of corpus symbols.
+   * @param pool Pool the new nodes are allocated from.
+   * @param model T9 model used to access all information required to insert the symbol.
+   */
+  void
+  expand(t9_symbol_id symbol, t9_symbol_id_view context, std::vector<float> &costs, SearchNodePool &pool,
+         Model *model);
+
+  /**
+   * Remove a child from the list of children.
+   * @param child Child of this node.
+   */
+  void
+  unlink_child(SearchNode *child);
+
   // Parent node.
   observer_ptr<SearchNode> parent;
+
+  // First and last child of the node. The children are linked to each other in the order of their creation.
+  SearchNode *first_child;
+  SearchNode *last_child;
+
+  // Neighbouring children of the parent node. Released nodes are linked into the free list of their pool.
+  SearchNode *previous_sibling;
+  SearchNode *next_sibling;
+};
+
+/**
+ * Slab allocator handing out the search nodes of a search tree.
+ *
+ * Nodes are carved from slabs of T9_SEARCH_NODE_SLAB_SIZE nodes. Released nodes are kept in a free list and handed
+ * out again before the next unused node. Search nodes own no memory, hence resetting the pool just rewinds it to the
+ * beginning of its first slab, without visiting any node. The slabs are kept for reuse until the pool is destructed.
+ */
+class SearchNodePool {
+ public:
+  /**
+   * Construct an empty pool.
+   */
+  SearchNodePool();
+
+  /**
+   * Free all slabs of the pool.
+   */
+  ~SearchNodePool();
+
+  SearchNodePool(const SearchNodePool &) = delete;
+  SearchNodePool &operator=(const SearchNodePool &) = delete;
+
+  /**
+   * Construct a search node.
+   * @param symbol Corpus symbol identifier.
+   * @param probability Probability of the search node.
+   * @return Pointer to the new node.
+   */
+  SearchNode *
+  create(t9_symbol_id symbol, float probability);
+
+  /**
+   * Return a node to the pool. Its children have to be released on their own.
+   * @param node Node created by this pool.
+   */
+  void
+  release(SearchNode *node);
+
+  /**
+   * Release all nodes at once.
+   */
+  void
+  reset();
+
+  /**
+   * Get the number of nodes in use.
+   * @return Number of created nodes that were not released.
+   */
+  size_t
+  size() const;
+
+  /**
+   * Get the number of bytes occupied by the slabs of the pool.
+   * @return Size of all slabs in bytes.
+   */
+  size_t
+  memory_usage() const;
+
+ protected:
+  // Slabs of uninitialized nodes.
+  std::vector<SearchNode *> slabs;
+
+  // Slab and position within the slab of the next unused node.
+  size_t slab;
+  size_t position;
+
+  // Released nodes, linked through their next sibling.
+  SearchNode *free_list;
+
+  // Number of nodes in use.
+  size_t n_nodes;
 };
 
 }  // namesapce t9
@@ -66,10 +66,10 @@ class SearchPath {
   std::size_t size() const;
 
   /**
-   * Generate a string from the path.
-   * @return String.
+   * Generate a sequence of corpus symbol identifiers from the path.
+   * @return Sequence of symbol identifiers.
    */
-  t9_symbol_sequence to_string() const;
+  t9_symbol_id_sequence to_sequence() const;
 
   /**
    * Get the probability of the path.
@@ -94,6 +94,82 @@ class SearchPath {
   }
 };
 
+/**
+ * Bounded max-heap of the best leaves of a search tree, the worst of the kept leaves on top.
+ *
+ * Offering a leaf costs O(log max_paths). Only the leaf is stored, the paths are built from the parent pointers of the
+ * kept leaves once the search is done, hence rejected leaves are never copied. Leaves of equal probability are ranked
+ * in the order they were offered, earlier leaves first.
+ */
+class SearchPathHeap {
+ public:
+  /**
+   * Construct an empty heap.
+   * @param max_paths Maximal number of best paths to keep track of.
+   */
+  explicit SearchPathHeap(size_t max_paths);
+
+  /**
+   * Check if a probability (cost) can not enter the heap.
+   * @param probability Probability of a leaf or of the root of a subtree.
+   * @return true if the heap is full and the probability is not better than the worst kept leaf, false otherwise.
+   */
+  inline bool
+  is_rejected(float probability) const {
+    return entries.size() >= max_paths && (max_paths == 0 || probability >= entries.front().probability);
+  }
+
+  /**
+   * Offer a leaf to the heap. The worst leaf is dropped if the heap is full.
+   * @param leaf Leaf node of the search tree that is not rejected.
+   */
+  void
+  offer(SearchNode *leaf);
+
+  /**
+   * Drop all leaves.
+   */
+  void
+  clear();
+
+  /**
+   * Build the paths of all kept leaves.
+   * @param best_paths Collection the paths are written to, best path first.
+   */
+  void
+  extract(std::vector<SearchPath> &best_paths);
+
+ protected:
+  /**
+   * Leaf kept by the heap.
+   */
+  struct Entry {
+    // Probability (cost) of the path ending in the leaf.
+    float probability;
+    // Number of leaves offered before the leaf.
+    size_t order;
+    // Leaf node of the path.
+    SearchNode *leaf;
+
+    inline bool
+    operator<(const Entry &other) const {
+      return probability < other.probability || (probability == other.probability && order < other.order);
+    }
+  };
+
+  // Maximal number of best paths to keep track of.
+  size_t max_paths;
+
+  // Number of leaves offered since the heap was cleared.
+  size_t n_offered;
+
+  // Kept leaves, ordered as a max-heap.
+  std::vector<Entry> entries;
+
+  // Temporary buffer of the nodes of a path.
+  std::vector<SearchNode *> nodes;
+};
+
 }  // namespace t9
 
 #endif //CPP_T9_PATH_HPP
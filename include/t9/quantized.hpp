@@ -0,0 +1,90 @@
+// T9 quantized corpus tree -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#ifndef CPP_T9_QUANTIZED_HPP
+#define CPP_T9_QUANTIZED_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "t9/symbols.hpp"
+#include "t9/frozen.hpp"
+#include "t9/language_model.hpp"
+
+namespace t9 {
+
+/**
+ * Compact read-only corpus tree storing quantized costs.
+ *
+ * The tree structure is copied from a frozen corpus tree. Instead of probabilities, costs and counts, each node only
+ * stores an 8 or 16 bit code indexing a codebook of costs that is shared by all nodes. The codebook is built from
+ * equally populated bins of the sorted node costs, each code decodes to the mean cost of its bin.
+ */
+class QuantizedCorpusTree : public LanguageModel {
+ public:
+  /**
+   * Quantize a frozen corpus tree.
+   * @param tree Frozen corpus tree to quantize.
+   * @param bits Number of bits per code, either 8 or 16.
+   */
+  QuantizedCorpusTree(const FrozenCorpusTree &tree, size_t bits);
+
+  float
+  conditional_probability(t9_symbol_id_view sequence) const override;
+
+  float
+  conditional_cost(t9_symbol_id_view sequence) const override;
+
+  void
+  conditional_costs(t9_symbol_id_view context, std::vector<float> &costs) const override;
+
+  size_t
+  memory_usage() const override;
+
+  /**
+   * Get the largest absolute deviation between a quantized cost and the original cost of a node.
+   * @return Maximal quantization error.
+   */
+  float
+  max_error() const;
+
+ protected:
+  /**
+   * Find the node a symbol sequence ends in.
+   * @param sequence Corpus symbol sequence.
+   * @return Index of the node if the sequence is in the tree. Otherwise 0.
+   */
+  uint32_t
+  find_node(t9_symbol_id_view sequence) const;
+
+  // Number of bits per code.
+  size_t bits;
+
+  // Cost assigned to sequences that are not contained in the tree.
+  float unseen_cost;
+
+  // Largest absolute quantization error.
+  float error;
+
+  // Cost each code decodes to.
+  std::vector<float> codebook;
+
+  // Corpus symbol identifier of each node.
+  std::vector<t9_symbol_id> symbols;
+
+  // Index of the first child of each node. The children of node i are [first_child[i], first_child[i + 1]).
+  std::vector<uint32_t> first_child;
+
+  // Cost codes of the nodes, only one of both is populated depending on the number of bits.
+  std::vector<uint8_t> codes_8;
+  std::vector<uint16_t> codes_16;
+};
+
+}  // namespace t9
+
+#endif //CPP_T9_QUANTIZED_HPP
@@ -0,0 +1,127 @@
+// T9 typing session -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#ifndef CPP_T9_SESSION_HPP
+#define CPP_T9_SESSION_HPP
+
+#include <utility>
+#include <vector>
+
+#include "t9/symbols.hpp"
+#include "t9/beam.hpp"
+#include "t9/model.hpp"
+#include "t9/timer.hpp"
+
+// Default number of typed keys that can be erased without typing the remaining keys again.
+#define T9_SESSION_MAX_CHECKPOINTS 64
+
+namespace t9 {
+
+/**
+ * Incremental typing session on a model, e.g. one per text field of an input method.
+ *
+ * Keys are typed one at a time. Each key only advances the beam of the session by one step, the keys typed before are
+ * never searched again. Backspace restores the beam before the last key from a checkpoint. Only when more keys are
+ * erased than checkpoints are kept, the remaining keys are typed again from the start.
+ *
+ * The session always uses the beam decoder and owns it, the decoder of the model is not touched. Hence several
+ * sessions can share one model, as long as the model is not modified while they are in use. Hypotheses are recombined
+ * like in the beam decoder of the model.
+ */
+class TypingSession {
+ public:
+  /**
+   * Construct an empty session.
+   * @param model Trained model to search the suggestions with.
+   * @param max_checkpoints Maximal number of typed keys that can be erased without typing the remaining keys again.
+   */
+  explicit TypingSession(Model &model, size_t max_checkpoints = T9_SESSION_MAX_CHECKPOINTS);
+
+  /**
+   * Type a single key.
+   * @param key T9 key.
+   * @return Suggestions for all keys typed so far, best suggestion first.
+   */
+  const std::vector<std::pair<t9_symbol_sequence, float>> &
+  type(t9_symbol key);
+
+  /**
+   * Erase the last typed key. Nothing happens if no key was typed.
+   * @return Suggestions for the remaining keys, best suggestion first.
+   */
+  const std::vector<std::pair<t9_symbol_sequence, float>> &
+  backspace();
+
+  /**
+   * Erase all typed keys.
+   */
+  void
+  clear();
+
+  /**
+   * Get the suggestions for all keys typed so far.
+   * @return Suggestions and their scores, best suggestion first.
+   */
+  const std::vector<std::pair<t9_symbol_sequence, float>> &
+  suggestions() const;
+
+  /**
+   * Get the keys typed so far.
+   * @return Sequence of T9 keys.
+   */
+  const t9_symbol_sequence &
+  keys() const;
+
+  /**
+   * Get the latency of each key typed so far, including building its suggestions.
+   * @return Latencies in milliseconds, in the order of the keys.
+   */
+  const std::vector<double> &
+  latencies_ms() const;
+
+  /**
+   * Get the latency of the last call to `type()` or `backspace()`.
+   * @return Latency in milliseconds.
+   */
+  double
+  last_latency_ms() const;
+
+ protected:
+  /**
+   * Build the suggestions from the best paths of the decoder.
+   */
+  void
+  update_suggestions();
+
+  // Model the suggestions are searched with.
+  Model &model;
+
+  // Beam of the session.
+  BeamDecoder decoder;
+
+  // Keys typed so far.
+  t9_symbol_sequence input;
+
+  // Latency of each typed key in milliseconds.
+  std::vector<double> latencies;
+
+  // Latency of the last call in milliseconds.
+  double latency;
+
+  // Suggestions for the keys typed so far.
+  std::vector<std::pair<t9_symbol_sequence, float>> current_suggestions;
+
+  // Temporary buffer of the best paths of the decoder.
+  std::vector<std::pair<t9_symbol_id_sequence, float>> paths;
+
+  timer key_timer;
+};
+
+}  // namespace t9
+
+#endif //CPP_T9_SESSION_HPP
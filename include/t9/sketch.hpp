@@ -0,0 +1,109 @@
+// T9 count-min sketch -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#ifndef CPP_T9_SKETCH_HPP
+#define CPP_T9_SKETCH_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "t9/symbols.hpp"
+#include "t9/corpus.hpp"
+#include "t9/language_model.hpp"
+
+namespace t9 {
+
+/**
+ * Ngram model counting approximately in a count-min sketch of fixed size.
+ *
+ * Every prefix of every train ngram is counted in `depth` rows of counters, each selected by a different hash of the
+ * sequence. The count of a sequence is estimated as the minimum of its counters. Counts are never underestimated,
+ * collisions only lead to overestimates. With conservative update, a counter is only raised as far as required to
+ * keep the estimate of the counted sequence correct, which reduces the overestimation of all other sequences.
+ *
+ * The memory of the sketch does not depend on the amount of train data, which allows training on streams of any size.
+ */
+class CountMinSketchModel : public LanguageModel {
+ public:
+  /**
+   * Count all ngrams of a corpus into a count-min sketch.
+   * @param corpus Corpus to be used for ngram generation.
+   * @param ngram_length Length of the ngrams to be generated.
+   * @param max_bytes Size of the counters in bytes.
+   * @param depth Number of rows of counters.
+   */
+  CountMinSketchModel(const Corpus &corpus, size_t ngram_length, size_t max_bytes, size_t depth);
+
+  float
+  conditional_probability(t9_symbol_id_view sequence) const override;
+
+  float
+  conditional_cost(t9_symbol_id_view sequence) const override;
+
+  void
+  conditional_costs(t9_symbol_id_view context, std::vector<float> &costs) const override;
+
+  size_t
+  memory_usage() const override;
+
+  /**
+   * Estimate the number of occurrences of a sequence as a prefix of the train ngrams.
+   * @param sequence Corpus symbol sequence.
+   * @return Estimated count, never less than the exact count.
+   */
+  uint32_t
+  estimate(t9_symbol_id_view sequence) const;
+
+ protected:
+  /**
+   * Calculate the probability of a sequence from its estimated count and the estimated count of its context.
+   * @param count Estimated count of the sequence.
+   * @param context_count Estimated count of the sequence without its last symbol.
+   * @return Conditional probability, limited to 1.
+   */
+  static float
+  probability(uint64_t count, uint64_t context_count);
+
+  /**
+   * Get the counter of a sequence in each row.
+   * @param sequence Corpus symbol sequence.
+   * @param cells Collection the counter indices are written to, one per row.
+   */
+  void
+  locate(t9_symbol_id_view sequence, std::vector<size_t> &cells) const;
+
+  /**
+   * Count one occurrence of a sequence using conservative update.
+   * @param sequence Corpus symbol sequence.
+   * @param cells Temporary collection of counter indices.
+   */
+  void
+  increment(t9_symbol_id_view sequence, std::vector<size_t> &cells);
+
+  // Counters of all rows, row after row. Counters saturate instead of overflowing.
+  std::vector<uint32_t> counters;
+
+  // Number of rows.
+  size_t depth;
+
+  // Number of counters per row.
+  size_t width;
+
+  // Length of the longest counted sequences.
+  size_t ngram_length;
+
+  // Number of counted ngrams, the count of the empty context.
+  uint64_t n_ngrams;
+
+  // Cost assigned to unknown sequences.
+  float unseen_cost;
+};
+
+}  // namespace t9
+
+#endif //CPP_T9_SKETCH_HPP
@@ -0,0 +1,186 @@
+// T9 count snapshot -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#ifndef CPP_T9_SNAPSHOT_HPP
+#define CPP_T9_SNAPSHOT_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "t9/symbols.hpp"
+#include "t9/corpus.hpp"
+#include "t9/tree.hpp"
+
+// Magic bytes and format version identifying a count snapshot file.
+#define T9_SNAPSHOT_FILE_MAGIC "T9COUNT"
+#define T9_SNAPSHOT_FILE_VERSION 1
+
+// Maximal number of snapshot files merged in a single pass.
+#define T9_SNAPSHOT_MERGE_FAN_IN 64
+
+// Number of records read from or written to a snapshot file at once.
+#define T9_SNAPSHOT_BUFFER_RECORDS 4096
+
+namespace t9 {
+
+/**
+ * Sequential reader of a count snapshot file.
+ *
+ * A count snapshot holds the counts of all ngrams of one part (shard) of the train data. Every ngram is stored as a
+ * record of its symbols and its count, the records are sorted lexicographically by their symbols. Together with the
+ * first and last `ngram_length - 1` symbols of the shard, which are required to count the ngrams spanning the borders
+ * of neighbouring shards, snapshots of consecutive shards can be merged into the snapshot of the whole train data.
+ *
+ * Counting, merging and loading snapshots only ever holds a few records of each file in memory. Shards can therefore be
+ * counted by separate processes and merged into a model larger than the memory of any of them.
+ */
+class CountSnapshot {
+ public:
+  /**
+   * Open a count snapshot file and read its header.
+   * @param file_path Path to a snapshot file written by `count()` or `merge()`.
+   */
+  explicit CountSnapshot(const std::filesystem::path &file_path);
+
+  /**
+   * Count all ngrams of the train data of a corpus and write them to a count snapshot file.
+   * Streamed train data is counted chunk by chunk, hence the train data never has to be held in memory.
+   * @param corpus Corpus whose train data is one shard of the whole train data.
+   * @param ngram_length Length of the ngrams to be counted.
+   * @param n_threads Number of threads to use for counting train data held in memory.
+   * @param file_path Path of the snapshot file to be written. An existing file is replaced.
+   */
+  static void
+  count(const Corpus &corpus, size_t ngram_length, size_t n_threads, const std::filesystem::path &file_path);
+
+  /**
+   * Merge the count snapshots of consecutive shards into the count snapshot of their concatenation.
+   * The ngrams spanning the borders of the shards are counted as well, hence the result is identical to counting the
+   * concatenated train data at once. The snapshots are merged in passes of at most `T9_SNAPSHOT_MERGE_FAN_IN` files,
+   * intermediate results are written next to the output file.
+   * @param file_paths Paths to the snapshot files in the order of their shards.
+   * @param output_file_path Path of the merged snapshot file to be written. An existing file is replaced.
+   */
+  static void
+  merge(const std::vector<std::filesystem::path> &file_paths, const std::filesystem::path &output_file_path);
+
+  /**
+   * Read the next record of the snapshot.
+   * @param ngram Sequence the symbols of the ngram are written to.
+   * @param count Number of occurrences of the ngram.
+   * @return false if all records were read, true otherwise.
+   */
+  bool
+  next(t9_symbol_id_sequence &ngram, uint64_t &count);
+
+  /**
+   * Restart reading at the first record of the snapshot.
+   */
+  void
+  rewind();
+
+  /**
+   * Populate a corpus tree with all remaining records of the snapshot.
+   * @param tree Empty corpus tree to populate.
+   */
+  void
+  build_corpus_tree(CorpusTree &tree);
+
+  /**
+   * Get the length of the counted ngrams.
+   * @return Ngram length.
+   */
+  size_t
+  ngram_length() const;
+
+  /**
+   * Get the corpus symbols the snapshot was counted with.
+   * @return Sequence of all corpus symbols in the order of their identifiers.
+   */
+  t9_symbol_sequence
+  alphabet() const;
+
+  /**
+   * Get the number of distinct ngrams in the snapshot.
+   * @return Number of records.
+   */
+  size_t
+  n_records() const;
+
+  /**
+   * Get the number of symbols of the counted train data.
+   * @return Length of the shard.
+   */
+  size_t
+  text_length() const;
+
+ protected:
+  /**
+   * Layout of the header at the beginning of a snapshot file.
+   * The header is followed by the first and the last symbols of the shard and the records.
+   */
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t ngram_length;
+    uint64_t n_symbols;
+    t9_symbol alphabet[256];
+    uint64_t n_records;
+    uint64_t text_length;
+    uint64_t n_head;
+    uint64_t n_tail;
+  };
+
+  /**
+   * Write the header and the first and last symbols of the shard to the beginning of a snapshot file.
+   * @param file Snapshot file being written.
+   * @param header Header of the snapshot.
+   * @param head First symbols of the shard.
+   * @param tail Last symbols of the shard.
+   */
+  static void
+  write_header(std::ofstream &file, const Header &header, t9_symbol_id_view head, t9_symbol_id_view tail);
+
+  /**
+   * Merge at most `T9_SNAPSHOT_MERGE_FAN_IN` snapshot files of consecutive shards in a single pass.
+   * @param file_paths Paths to the snapshot files in the order of their shards.
+   * @param output_file_path Path of the merged snapshot file to be written.
+   */
+  static void
+  merge_pass(const std::vector<std::filesystem::path> &file_paths, const std::filesystem::path &output_file_path);
+
+  // Path of the snapshot file, used in error messages.
+  std::filesystem::path file_path;
+
+  // Snapshot file, positioned at the next unbuffered record.
+  std::ifstream file;
+
+  // Header of the snapshot file.
+  Header header;
+
+  // First and last `ngram_length - 1` symbols of the shard. Both hold the whole shard if it is shorter.
+  t9_symbol_id_sequence head;
+  t9_symbol_id_sequence tail;
+
+  // Buffered records and the position of the next record within the buffer.
+  std::vector<uint8_t> buffer;
+  size_t buffer_position;
+
+  // Number of records read from the file so far.
+  uint64_t n_read;
+
+  // Most recently returned ngram, used to verify the order of the records.
+  t9_symbol_id_sequence previous;
+};
+
+}  // namespace t9
+
+#endif //CPP_T9_SNAPSHOT_HPP
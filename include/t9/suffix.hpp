@@ -0,0 +1,82 @@
+// T9 suffix array -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#ifndef CPP_T9_SUFFIX_HPP
+#define CPP_T9_SUFFIX_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "t9/symbols.hpp"
+#include "t9/corpus.hpp"
+#include "t9/tree.hpp"
+
+namespace t9 {
+
+/**
+ * Suffix array and LCP array over the train data of a corpus.
+ *
+ * The suffix array lists the start positions of all suffixes of the train data in lexicographic order, hence all
+ * occurrences of a ngram form one contiguous interval. The LCP array holds the length of the common prefix of each
+ * suffix and its predecessor. Once built, ngrams of any length can be counted and corpus trees of any ngram length can
+ * be emitted without scanning the train data again.
+ */
+class SuffixArray {
+ public:
+  /**
+   * Build the suffix array and the LCP array over the train data of a corpus.
+   * The train data has to be held in memory and must outlive the suffix array.
+   * @param corpus Corpus whose train data is indexed.
+   */
+  explicit SuffixArray(const Corpus &corpus);
+
+  /**
+   * Count the occurrences of a ngram in the train data.
+   * @param ngram Corpus symbol sequence of any length.
+   * @return Number of positions the ngram starts at.
+   */
+  size_t
+  count(t9_symbol_id_view ngram) const;
+
+  /**
+   * Populate a corpus tree with all ngrams of a given length.
+   * The resulting counts are identical to inserting the ngrams with `CorpusTree::insert_ngrams()`.
+   * @param ngram_length Length of the ngrams.
+   * @param tree Empty corpus tree to populate.
+   */
+  void
+  build_corpus_tree(size_t ngram_length, CorpusTree &tree) const;
+
+  /**
+   * Get the corpus the suffix array was built over.
+   * @return Indexed corpus.
+   */
+  const Corpus &
+  get_corpus() const;
+
+  /**
+   * Get the number of bytes occupied by the suffix array and the LCP array.
+   * @return Size of both arrays in bytes.
+   */
+  size_t
+  memory_usage() const;
+
+ protected:
+  // Corpus whose train data is indexed.
+  const Corpus &corpus;
+
+  // Start positions of all suffixes in lexicographic order.
+  std::vector<uint32_t> suffixes;
+
+  // Length of the common prefix of each suffix and its predecessor in the suffix array. The first entry is 0.
+  std::vector<uint32_t> lcp;
+};
+
+}  // namespace t9
+
+#endif //CPP_T9_SUFFIX_HPP
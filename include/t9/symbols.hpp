@@ -9,9 +9,107 @@
 #ifndef CPP_T9_SYMBOLS_HPP
 #define CPP_T9_SYMBOLS_HPP
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+#include <ios>
 #include <string>
+#include <string_view>
 
 typedef char t9_symbol;
 typedef std::string t9_symbol_sequence;
 
+// Dense identifiers assigned to T9 keys and corpus symbols by the corpus.
+typedef uint8_t t9_symbol_id;
+
+/**
+ * Character traits of symbol identifiers.
+ * The standard only defines `std::char_traits` for character types, the generic template some standard libraries
+ * provide for other types is deprecated or removed. Identifiers are compared as unsigned bytes.
+ */
+struct t9_symbol_id_traits {
+  typedef t9_symbol_id char_type;
+  typedef int int_type;
+  typedef std::streamoff off_type;
+  typedef std::streampos pos_type;
+  typedef std::mbstate_t state_type;
+
+  static constexpr void
+  assign(char_type &target, const char_type &source) noexcept {
+    target = source;
+  }
+
+  static constexpr bool
+  eq(char_type a, char_type b) noexcept {
+    return a == b;
+  }
+
+  static constexpr bool
+  lt(char_type a, char_type b) noexcept {
+    return a < b;
+  }
+
+  static int
+  compare(const char_type *a, const char_type *b, size_t n) {
+    return n == 0 ? 0 : std::memcmp(a, b, n);
+  }
+
+  static size_t
+  length(const char_type *sequence) {
+    return std::strlen(reinterpret_cast<const char *>(sequence));
+  }
+
+  static const char_type *
+  find(const char_type *sequence, size_t n, const char_type &value) {
+    return n == 0 ? nullptr : static_cast<const char_type *>(std::memchr(sequence, value, n));
+  }
+
+  static char_type *
+  move(char_type *target, const char_type *source, size_t n) {
+    return n == 0 ? target : static_cast<char_type *>(std::memmove(target, source, n));
+  }
+
+  static char_type *
+  copy(char_type *target, const char_type *source, size_t n) {
+    return n == 0 ? target : static_cast<char_type *>(std::memcpy(target, source, n));
+  }
+
+  static char_type *
+  assign(char_type *target, size_t n, char_type value) {
+    return n == 0 ? target : static_cast<char_type *>(std::memset(target, value, n));
+  }
+
+  static constexpr char_type
+  to_char_type(int_type value) noexcept {
+    return static_cast<char_type>(value);
+  }
+
+  static constexpr int_type
+  to_int_type(char_type value) noexcept {
+    return static_cast<int_type>(value);
+  }
+
+  static constexpr bool
+  eq_int_type(int_type a, int_type b) noexcept {
+    return a == b;
+  }
+
+  static constexpr int_type
+  eof() noexcept {
+    return -1;
+  }
+
+  static constexpr int_type
+  not_eof(int_type value) noexcept {
+    return value == eof() ? 0 : value;
+  }
+};
+
+typedef std::basic_string<t9_symbol_id, t9_symbol_id_traits> t9_symbol_id_sequence;
+typedef std::basic_string_view<t9_symbol_id, t9_symbol_id_traits> t9_symbol_id_view;
+
+// Identifier returned for symbols that are not part of the corpus.
+#define T9_INVALID_SYMBOL_ID 0xFF
+
 #endif //CPP_T9_SYMBOLS_HPP
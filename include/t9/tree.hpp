@@ -5,6 +5,8 @@
 #include <list>
 #include <vector>
 #include <algorithm>
+#include <memory>
+#include <thread>
 
 namespace t9 {
 class Model;
@@ -17,13 +19,28 @@ class SearchNode;
 #include "t9/path.hpp"
 #include "t9/corpus.hpp"
 #include "t9/generator.hpp"
+#include "t9/language_model.hpp"
 
 namespace t9 {
 
+/**
+ * Scores deciding which branches of a corpus tree are pruned first.
+ */
+enum class PruneCriterion {
+  // Prune the nodes with the lowest counts.
+  COUNT,
+  // Prune the nodes whose removal loses the least train log likelihood, when removed ngrams fall back to the cost of
+  // an unseen sequence and the remaining probabilities are renormalized. Without back off the unseen cost dominates,
+  // hence this orders by count first and breaks ties by the remaining loss.
+  ENTROPY,
+};
+
 /**
  * The corpus tree is used to build a ngram based statistical model of conditional symbol probabilities.
+ * When queried directly, probabilities are derived from the node counts at lookup time. This keeps the tree valid
+ * while further ngrams are inserted into it.
  */
-class CorpusTree {
+class CorpusTree : public LanguageModel {
  public:
   // Root note of the tree.
   t9::CorpusNode *root;
@@ -40,11 +57,15 @@ class CorpusTree {
 
   /**
    * Given a corpus insert all possible ngrams of a given length into a corpus tree.
+   * With more than one thread the train data is split into overlapping ranges which are counted into separate shards.
+   * The shards are merged into the tree afterwards, resulting in the same counts as a serial build.
+   * Streamed train data is always counted serially, chunk by chunk.
    * @param corpus Corpus to be used for ngram generation.
    * @param ngram_length Length of the ngrams to be generated.
+   * @param n_threads Number of threads to use for counting.
    */
   void
-  insert_ngrams(const Corpus &corpus, size_t ngram_length);
+  insert_ngrams(const Corpus &corpus, size_t ngram_length, size_t n_threads = 1);
 
   /**
    * Calculate the conditional probabilities for all tree nodes.
@@ -52,13 +73,72 @@ class CorpusTree {
   void
   calculate_probabilities();
 
+  /**
+   * Insert all ngrams of a sequence into the corpus tree.
+   * Only the counts of the nodes along the paths of the inserted ngrams are updated.
+   * @param data Sequence of corpus symbol identifiers.
+   * @param ngram_length Length of the ngrams to be generated.
+   */
+  void
+  insert_sequence(t9_symbol_id_view data, size_t ngram_length);
+
   /**
    * Calculate the probability of a symbol sequence in the corpus tree.
    * @param sequence Corpus symbol sequence whose probability should be calculated.
    * @return Probability of the sequence if the sequence was found in the tree. Otherwise 0.0.
    */
   float
-  conditional_probability(const std::string &sequence) const;
+  conditional_probability(t9_symbol_id_view sequence) const override;
+
+  float
+  conditional_cost(t9_symbol_id_view sequence) const override;
+
+  void
+  conditional_costs(t9_symbol_id_view context, std::vector<float> &costs) const override;
+
+  /**
+   * Get the costs of many symbol sequences in the corpus tree at once.
+   * All lookups descend the tree level by level in lockstep. The children of the nodes reached in one step are
+   * prefetched before any of them is searched, hence the cache misses of independent lookups overlap.
+   * @param sequences Corpus symbol sequences whose costs should be calculated.
+   * @param costs Collection the costs are written to, in the order of the sequences.
+   */
+  void
+  conditional_cost_batch(const std::vector<t9_symbol_id_view> &sequences, std::vector<float> &costs) const override;
+
+  size_t
+  memory_usage() const override;
+
+  /**
+   * Get the number of nodes in the tree (including the root node).
+   * @return Number of nodes.
+   */
+  size_t
+  size() const;
+
+  /**
+   * Remove rarely used branches from the tree.
+   * First all nodes seen less than `min_count` times are removed. Afterwards leaves are removed in the order of their
+   * score until at most `max_nodes` nodes remain. Nodes directly below the root are never removed. The counts of the
+   * remaining nodes are kept, `calculate_probabilities()` renormalizes them.
+   * @param criterion Score deciding which leaves are removed first.
+   * @param min_count Minimal count of a node to be kept.
+   * @param max_nodes Maximal number of nodes to keep. A value of 0 does not limit the number of nodes.
+   * @return Number of removed nodes.
+   */
+  size_t
+  prune(PruneCriterion criterion, size_t min_count, size_t max_nodes);
+
+ protected:
+  /**
+   * Insert all ngrams starting within a range of the train data into the corpus tree.
+   * @param corpus Corpus to be used for ngram generation.
+   * @param ngram_length Length of the ngrams to be generated.
+   * @param begin Position of the first ngram to insert.
+   * @param end Position one past the last ngram to insert.
+   */
+  void
+  insert_ngram_range(const Corpus &corpus, size_t ngram_length, size_t begin, size_t end);
 };
 
 /**
@@ -78,22 +158,28 @@ class SearchTree {
    */
   ~SearchTree();
 
+  /**
+   * Discard all typed keys. The memory of the nodes is kept and reused for the next search.
+   */
+  void
+  reset();
+
   /**
    * Type a sequence of keys into the search tree and calculate the best text suggestions for the entered keys.
-   * @param sequence Sequence of T9 keys to enter.
+   * @param sequence Sequence of T9 key identifiers to enter.
    * @param model Model to be used for searching the best text suggestions.
    */
   void
-  type(const t9_symbol_sequence &sequence, Model *model);
+  type(const t9_symbol_id_sequence &sequence, Model *model);
 
   /**
    * Type a single symbol into a search tree and update the whole model.
    * This includes searching the best paths and pruning the model.
-   * @param symbol T9 key to type.
+   * @param symbol Identifier of the T9 key to type.
    * @param model T9 model.
    */
   void
-  insert(t9_symbol symbol, Model *model);
+  insert(t9_symbol_id symbol, Model *model);
 
   /**
    * Update the list of best scoring paths in the tree.
@@ -121,6 +207,12 @@ class SearchTree {
   SearchNode *root;
 
  protected:
+  // Pool all nodes of the tree are allocated from.
+  SearchNodePool pool;
+
+  // Best leaves found while searching the paths.
+  SearchPathHeap heap;
+
   // Depth of the tree.
   size_t depth;
 };
@@ -11,7 +11,10 @@
 #include <unordered_map>
 #include <iterator>
 #include <iomanip>
+#include <thread>
+#include <random>
 #include <t9/model.hpp>
+#include <t9/session.hpp>
 
 #include "t9/timer.hpp"
 
@@ -61,6 +64,326 @@ void example_evaluate(t9::Model &model) {
             << std::endl;
 }
 
+void example_save_and_load(t9::Model &model, const std::filesystem::path &model_file_path) {
+  // Store the trained model in a binary file and serve it from a memory mapping of that file.
+
+  t9::timer timer;
+
+  timer.restart();
+  model.save_corpus_tree(model_file_path);
+  timer.stop();
+  std::cout << "Saving the model took: "
+            << std::fixed << std::setprecision(2) << timer.duration_ms() << " ms"
+            << std::endl;
+
+  timer.restart();
+  model.load_corpus_tree(model_file_path);
+  timer.stop();
+  std::cout << "Loading the model took: "
+            << std::fixed << std::setprecision(2) << timer.duration_ms() << " ms"
+            << std::endl;
+}
+
+void example_update(t9::Model &model, const t9_symbol_sequence &text) {
+  // Adapt a trained model to new text without retraining it.
+
+  t9::timer timer;
+
+  timer.restart();
+  model.update(text);
+  timer.stop();
+  std::cout << "Updating the model with \"" << text << "\" took: "
+            << std::fixed << std::setprecision(2) << timer.duration_ms() << " ms"
+            << std::endl;
+}
+
+void example_prune(t9::Model &model, const t9::PruneOptions &prune_options) {
+  // Prune the frozen corpus tree and compare size and evaluation error before and after.
+
+  t9::PruneReport report;
+
+  example_evaluate(model);
+  report = model.prune_corpus_tree(prune_options);
+  std::cout << "Pruning removed " << report.n_nodes_before - report.n_nodes_after << " of "
+            << report.n_nodes_before << " nodes and " << report.n_bytes_before - report.n_bytes_after << " of "
+            << report.n_bytes_before << " bytes"
+            << std::endl;
+  example_evaluate(model);
+}
+
+void example_quantize(t9::Model &model, size_t bits) {
+  // Quantize the costs of the frozen corpus tree and compare size and evaluation error before and after.
+
+  float error;
+
+  std::cout << "Before quantization: size: " << model.language_model->memory_usage() << " bytes" << std::endl;
+  example_evaluate(model);
+
+  error = model.quantize_corpus_tree(bits);
+  std::cout << "After " << bits << " bit quantization: "
+            << "size: " << model.language_model->memory_usage() << " bytes, "
+            << "max. cost error: " << std::fixed << std::setprecision(4) << error
+            << std::endl;
+  example_evaluate(model);
+}
+
+void example_benchmark_lookups(t9::Model &model, size_t n_lookups, size_t batch_size) {
+  // Compare the throughput of one-at-a-time and batched language model lookups.
+
+  const t9_symbol_id_sequence &train_data = model.corpus.get_train_data();
+  std::vector<t9_symbol_id_sequence> sequences;
+  std::vector<t9_symbol_id_view> batch;
+  std::vector<float> costs;
+  std::mt19937 generator(42);
+  double single_sum = 0.0;
+  double batch_sum = 0.0;
+  t9::timer timer;
+
+  if (train_data.size() <= model.ngram_length) {
+    return;
+  }
+
+  // Draw ngrams from the train data. Every other ngram gets a random last symbol, which is mostly unseen.
+  for (size_t lookup = 0; lookup < n_lookups; lookup++) {
+    size_t position = generator() % (train_data.size() - model.ngram_length);
+    sequences.push_back(train_data.substr(position, model.ngram_length));
+    if (lookup % 2 == 1) {
+      sequences.back().back() = static_cast<t9_symbol_id>(generator() % model.corpus.n_symbols());
+    }
+  }
+
+  timer.restart();
+  for (const auto &sequence : sequences) {
+    single_sum += model.language_model->conditional_cost(sequence);
+  }
+  timer.stop();
+  std::cout << "Single lookups: " << std::fixed << std::setprecision(0)
+            << n_lookups / (timer.duration_ms() / 1000.0) << " lookups/s" << std::endl;
+
+  timer.restart();
+  for (size_t begin = 0; begin < sequences.size(); begin += batch_size) {
+    size_t end = std::min(begin + batch_size, sequences.size());
+    batch.assign(sequences.begin() + begin, sequences.begin() + end);
+    model.language_model->conditional_cost_batch(batch, costs);
+    for (float cost : costs) {
+      batch_sum += cost;
+    }
+  }
+  timer.stop();
+  std::cout << "Batched lookups (batch size " << batch_size << "): " << std::fixed << std::setprecision(0)
+            << n_lookups / (timer.duration_ms() / 1000.0) << " lookups/s"
+            << (single_sum == batch_sum ? "" : " (results differ!)") << std::endl;
+}
+
+void example_bloom_filter(t9::Model &model, float false_positive_rate, const t9_symbol_sequence &input) {
+  // Reject lookups of unseen ngrams with a bloom filter and report how many lookups it answered.
+
+  const t9::BloomFilteredModel *filtered_model = model.filter_unseen_sequences(false_positive_rate);
+  std::cout << "Bloom filter: size: " << filtered_model->filter_memory_usage() << " bytes" << std::endl;
+
+  model.reset_search_tree();
+  example_autocomplete(model, input);
+  std::cout << "Bloom filter: "
+            << "lookups: " << filtered_model->n_lookups() << ", "
+            << "hit rate: " << std::fixed << std::setprecision(3) << filtered_model->hit_rate() << ", "
+            << "false positive rate: " << std::fixed << std::setprecision(4) << filtered_model->false_positive_rate()
+            << std::endl;
+}
+
+void example_suffix_array(const t9::Corpus &corpus, size_t max_ngram_length, size_t n_paths) {
+  // Index the train data once and build models of several ngram lengths from the index.
+
+  t9::timer timer;
+
+  timer.restart();
+  t9::SuffixArray suffix_array(corpus);
+  timer.stop();
+  std::cout << "Building the suffix array took: "
+            << std::fixed << std::setprecision(2) << timer.duration_ms() << " ms, "
+            << "size: " << suffix_array.memory_usage() << " bytes"
+            << std::endl;
+
+  for (size_t ngram_length = 2; ngram_length <= max_ngram_length; ngram_length++) {
+    t9::Model model(corpus, ngram_length, n_paths);
+
+    timer.restart();
+    model.build_corpus_tree(suffix_array);
+    timer.stop();
+    std::cout << "Building the " << ngram_length << "-gram model took: "
+              << std::fixed << std::setprecision(2) << timer.duration_ms() << " ms, "
+              << "size: " << model.language_model->memory_usage() << " bytes"
+              << std::endl;
+  }
+}
+
+void example_count_snapshots(const t9::Corpus &corpus, const std::filesystem::path &train_file_path,
+                             const std::unordered_map<t9_symbol, t9_symbol_sequence> &keyboard,
+                             size_t ngram_length, size_t n_paths, size_t n_shards, const t9_symbol_sequence &input) {
+  // Count shards of the train data separately (e.g. in separate processes) and merge their counts into one model.
+
+  t9::timer timer;
+  std::vector<std::filesystem::path> snapshot_file_paths;
+  t9_symbol_sequence text = t9::io::load_text_file(train_file_path, 0);
+
+  timer.restart();
+  for (size_t shard = 0; shard < n_shards; shard++) {
+    std::filesystem::path shard_file_path = "shard-" + std::to_string(shard) + ".txt";
+    std::filesystem::path snapshot_file_path = "shard-" + std::to_string(shard) + ".counts";
+
+    // Split the train data into consecutive shards.
+    size_t begin = text.size() * shard / n_shards;
+    size_t end = text.size() * (shard + 1) / n_shards;
+    t9::io::save_binary_file(shard_file_path, text.data() + begin, end - begin);
+
+    // Each shard is streamed from disk and counted on its own.
+    t9::Corpus shard_corpus(shard_file_path, 0, train_file_path, 1, keyboard, 1024 * 1024);
+    t9::Model shard_model(shard_corpus, ngram_length, n_paths);
+    shard_model.save_count_snapshot(snapshot_file_path);
+    snapshot_file_paths.push_back(snapshot_file_path);
+  }
+  timer.stop();
+  std::cout << "Counting " << n_shards << " shards took: "
+            << std::fixed << std::setprecision(2) << timer.duration_ms() << " ms"
+            << std::endl;
+
+  timer.restart();
+  t9::CountSnapshot::merge(snapshot_file_paths, "merged.counts");
+  t9::Model model(corpus, ngram_length, n_paths);
+  model.load_count_snapshot("merged.counts");
+  timer.stop();
+  std::cout << "Merging the snapshots took: "
+            << std::fixed << std::setprecision(2) << timer.duration_ms() << " ms, "
+            << "size: " << model.language_model->memory_usage() << " bytes, "
+            << "best: \"" << model.autocomplete(input).front().first << "\""
+            << std::endl;
+}
+
+void example_compare_decoders(const t9::Corpus &corpus, size_t ngram_length, size_t n_paths,
+                              t9::ModelOptions options, const t9_symbol_sequence &input) {
+  // Type the keys one by one with each decoder and compare the latency per key.
+
+  const std::vector<std::pair<t9::SearchDecoder, const char *>> decoders = {
+      {t9::SearchDecoder::TREE, "tree"},
+      {t9::SearchDecoder::BEAM, "beam"},
+  };
+
+  t9::timer timer;
+
+  for (auto const &[decoder, name] : decoders) {
+    options.decoder = decoder;
+    t9::Model model(corpus, ngram_length, n_paths, options);
+    model.build_corpus_tree();
+
+    double total_ms = 0.0;
+    double max_ms = 0.0;
+    std::vector<std::pair<t9_symbol_sequence, float>> suggestions;
+    for (auto key : input) {
+      timer.restart();
+      suggestions = model.autocomplete(t9_symbol_sequence(1, key));
+      timer.stop();
+      total_ms += timer.duration_ms();
+      max_ms = std::max(max_ms, timer.duration_ms());
+    }
+
+    std::cout << "Decoder " << name << ": "
+              << std::fixed << std::setprecision(0) << input.size() / (total_ms / 1000.0) << " keys/s, "
+              << "mean latency: " << std::setprecision(3) << total_ms / input.size() << " ms, "
+              << "max latency: " << max_ms << " ms, "
+              << "best: \"" << suggestions.front().first << "\""
+              << std::endl;
+  }
+}
+
+void example_typing_session(t9::Model &model, const t9_symbol_sequence &input, size_t n_backspaces) {
+  // Type the keys one at a time into a session, erase some of them and report the latency of each step.
+
+  t9::TypingSession session(model);
+  t9::timer timer;
+
+  std::cout << std::endl << "Typing sequence key by key: " << input << std::endl;
+  for (auto key : input) {
+    auto const &suggestions = session.type(key);
+    std::cout << "    " << key << ": "
+              << std::fixed << std::setprecision(3) << session.last_latency_ms() << " ms, "
+              << "best: \"" << suggestions.front().first << "\""
+              << std::endl;
+  }
+
+  for (size_t index = 0; index < n_backspaces && !session.keys().empty(); index++) {
+    auto const &suggestions = session.backspace();
+    std::cout << "    <backspace>: "
+              << std::fixed << std::setprecision(3) << session.last_latency_ms() << " ms, "
+              << "best: \"" << (suggestions.empty() ? "" : suggestions.front().first) << "\""
+              << std::endl;
+  }
+
+  // Typing all remaining keys again is the alternative to restoring a checkpoint.
+  timer.start();
+  model.reset_search_tree();
+  model.autocomplete(session.keys());
+  timer.stop();
+  std::cout << "Typing the remaining " << session.keys().size() << " keys again would take: "
+            << std::fixed << std::setprecision(3) << timer.duration_ms() << " ms"
+            << std::endl;
+}
+
+void example_recombination(const t9::Corpus &corpus, size_t ngram_length, t9::ModelOptions options) {
+  // Evaluate beams of several sizes with and without recombining hypotheses of the same state.
+
+  t9::timer timer;
+
+  for (size_t n_paths : {4, 8, 15}) {
+    for (size_t paths_per_state : {0, 1}) {
+      options.paths_per_state = paths_per_state;
+      t9::Model model(corpus, ngram_length, n_paths, options);
+      model.build_corpus_tree();
+
+      timer.restart();
+      float error = model.evaluate();
+      timer.stop();
+
+      std::cout << "Paths: " << n_paths << ", "
+                << "paths per state: " << paths_per_state << ", "
+                << "error: " << std::fixed << std::setprecision(4) << error << ", "
+                << "took: " << std::setprecision(2) << timer.duration_ms() << " ms"
+                << std::endl;
+    }
+  }
+}
+
+void example_compare_backends(const t9::Corpus &corpus, size_t ngram_length, size_t n_paths,
+                              t9::ModelOptions options, const t9_symbol_sequence &input) {
+  // Build the model with each backend and compare their size and speed.
+
+  const std::vector<std::pair<t9::ModelBackend, const char *>> backends = {
+      {t9::ModelBackend::TRIE, "trie"},
+      {t9::ModelBackend::HASHED, "hashed"},
+      {t9::ModelBackend::DENSE, "dense"},
+      {t9::ModelBackend::SKETCH, "sketch"},
+  };
+
+  t9::timer timer;
+
+  for (auto const &[backend, name] : backends) {
+    options.backend = backend;
+    t9::Model model(corpus, ngram_length, n_paths, options);
+
+    timer.restart();
+    model.build_corpus_tree();
+    timer.stop();
+    std::cout << "Backend " << name << ": "
+              << "build: " << std::fixed << std::setprecision(2) << timer.duration_ms() << " ms, "
+              << "size: " << model.language_model->memory_usage() << " bytes, ";
+
+    timer.restart();
+    auto suggestions = model.autocomplete(input);
+    timer.stop();
+    std::cout << "autocomplete: " << std::fixed << std::setprecision(2) << timer.duration_ms() << " ms, "
+              << "best: \"" << suggestions.front().first << "\""
+              << std::endl;
+  }
+}
+
 int main() {
   // Lookup table mapping t9 keys to corpus symbols.
   std::unordered_map<t9_symbol, t9_symbol_sequence> key_2_corpus_table;
@@ -82,6 +405,7 @@ int main() {
 
   size_t ngram_length;
   size_t n_paths;
+  t9::ModelOptions options;
 
   t9::timer timer;
 
@@ -116,6 +440,9 @@ int main() {
   // Number best completion paths (completion sequences) to maintain.
   n_paths = 15;
 
+  // Count the train ngrams using all available hardware threads.
+  options.n_threads = std::max(1u, std::thread::hardware_concurrency());
+
   try {
     // Load the corpus from disk.
     timer.start();
@@ -127,7 +454,7 @@ int main() {
 
     // Build the model.
     timer.restart();
-    t9::Model model(corpus, ngram_length, n_paths);
+    t9::Model model(corpus, ngram_length, n_paths, options);
     model.build_corpus_tree();
     timer.stop();
     std::cout << "Building the model took: "
@@ -139,6 +466,48 @@ int main() {
 
 //     Example 2: Evaluate model using the test corpus.
 //    example_evaluate(model);
+
+//     Example 3: Save the model and serve it from the model file.
+//    example_save_and_load(model, "model.t9");
+//    example_autocomplete(model, "366253#87867");
+
+//     Example 4: Feed the model with further text (e.g. recently typed by a user).
+//    example_update(model, "Donald Trump is typing.");
+//    example_update(model, "Donald Trump is typing again.");
+//    example_autocomplete(model, "366253#87867");
+
+//     Example 5: Compare the model backends.
+//    example_compare_backends(corpus, ngram_length, n_paths, options, "366253#87867");
+
+//     Example 6: Quantize the model to reduce its size.
+//    example_quantize(model, 8);
+
+//     Example 7: Prune the model down to half of its size.
+//    t9::PruneOptions prune_options;
+//    prune_options.criterion = t9::PruneCriterion::ENTROPY;
+//    prune_options.max_bytes = model.language_model->memory_usage() / 2;
+//    example_prune(model, prune_options);
+
+//     Example 8: Benchmark batched language model lookups.
+//    example_benchmark_lookups(model, 1000000, 16);
+
+//     Example 9: Reject lookups of unseen ngrams with a bloom filter.
+//    example_bloom_filter(model, 0.01f, "366253#87867");
+
+//     Example 10: Build models of several ngram lengths from one suffix array.
+//    example_suffix_array(corpus, 6, n_paths);
+
+//     Example 11: Count four shards of the train data separately and merge their counts.
+//    example_count_snapshots(corpus, train_file_path, key_2_corpus_table, ngram_length, n_paths, 4, "366253#87867");
+
+//     Example 12: Compare the latency per key of the beam decoder and the search tree.
+//    example_compare_decoders(corpus, ngram_length, n_paths, options, "366253#87867");
+
+//     Example 13: Type keys one at a time into a typing session and erase some of them again.
+//    example_typing_session(model, "366253#87867#4677", 5);
+
+//     Example 14: Evaluate small beams with and without recombining hypotheses that end in the same symbols.
+//    example_recombination(corpus, ngram_length, options);
   }
   catch (const std::exception &ex) {
     std::cerr << ex.what() << std::endl;
@@ -0,0 +1,86 @@
+// T9 count snapshot merge tool -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <t9/snapshot.hpp>
+#include <t9/frozen.hpp>
+
+#include "t9/timer.hpp"
+
+void print_usage(const char *program) {
+  std::cerr << "Usage: " << program << " [-m <model file>] <merged snapshot> <snapshot> [<snapshot> ...]" << std::endl
+            << std::endl
+            << "Merge the count snapshots of consecutive train data shards, given in the order of their shards." << std::endl
+            << "With -m, the merged counts are also frozen into a model file." << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  std::filesystem::path model_file_path;
+  std::filesystem::path output_file_path;
+  std::vector<std::filesystem::path> snapshot_file_paths;
+
+  t9::timer timer;
+
+  // Parse the command line.
+  for (int index = 1; index < argc; index++) {
+    std::string argument(argv[index]);
+
+    if (argument == "-m" && index + 1 < argc) {
+      model_file_path = argv[++index];
+    } else if (argument.empty() || argument[0] == '-') {
+      print_usage(argv[0]);
+      return 1;
+    } else if (output_file_path.empty()) {
+      output_file_path = argument;
+    } else {
+      snapshot_file_paths.emplace_back(argument);
+    }
+  }
+
+  if (snapshot_file_paths.empty()) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  try {
+    // Merge the snapshots.
+    timer.start();
+    t9::CountSnapshot::merge(snapshot_file_paths, output_file_path);
+    timer.stop();
+
+    t9::CountSnapshot snapshot(output_file_path);
+    std::cout << "Merging " << snapshot_file_paths.size() << " snapshots took: "
+              << std::fixed << std::setprecision(2) << timer.duration_ms() << " ms, "
+              << "symbols: " << snapshot.text_length() << ", "
+              << "ngrams: " << snapshot.n_records()
+              << std::endl;
+
+    if (model_file_path.empty()) {
+      return 0;
+    }
+
+    // Recompute the probabilities from the merged counts and freeze them.
+    timer.restart();
+    t9::FrozenCorpusTree frozen_tree(snapshot);
+    frozen_tree.save(model_file_path);
+    timer.stop();
+    std::cout << "Writing the model took: "
+              << std::fixed << std::setprecision(2) << timer.duration_ms() << " ms, "
+              << "size: " << frozen_tree.memory_usage() << " bytes"
+              << std::endl;
+  } catch (const std::exception &error) {
+    std::cerr << error.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,409 @@
+// T9 beam decoder -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#include "t9/beam.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+#include "t9/model.hpp"
+
+// History position marking the symbols typed first, which have no predecessor.
+#define T9_BEAM_NO_PARENT std::numeric_limits<size_t>::max()
+
+// Minimal size of the history before it is compacted.
+#define T9_BEAM_MIN_HISTORY_LIMIT 4096
+
+namespace t9 {
+
+BeamDecoder::BeamDecoder(size_t ngram_length, size_t max_paths, size_t paths_per_state, size_t max_checkpoints)
+    : ngram_length(ngram_length),
+      max_paths(max_paths),
+      paths_per_state(paths_per_state),
+      is_recombining(false),
+      max_checkpoints(max_checkpoints),
+      depth(0),
+      history_limit(T9_BEAM_MIN_HISTORY_LIMIT) {
+  best.reserve(max_paths + 1);
+
+  reset();
+}
+
+void
+BeamDecoder::reset() {
+  // The empty path is the only hypothesis before the first key is typed. Clearing keeps the capacity of all arrays.
+  scores.assign(1, 0.0f);
+  contexts.assign(ngram_length - 1, 0);
+  positions.assign(1, T9_BEAM_NO_PARENT);
+  history_symbols.clear();
+  history_parents.clear();
+  history_limit = T9_BEAM_MIN_HISTORY_LIMIT;
+  best.clear();
+  checkpoints.clear();
+  depth = 0;
+}
+
+void
+BeamDecoder::type(const t9_symbol_id_sequence &sequence, Model *model) {
+  for (auto key : sequence) {
+    insert(key, model);
+  }
+}
+
+void
+BeamDecoder::insert(t9_symbol_id key, Model *model) {
+  const size_t n_symbols = model->corpus.n_symbols();
+  const size_t n_rows = scores.size();
+  const size_t context_size = ngram_length - 1;
+  const size_t context_length = std::min(depth, context_size);
+  const float *key_costs = model->costs_of_key(key);
+  const LanguageModel *language_model = model->language_model;
+
+  // Like the search tree, all hypotheses are kept until ngram_length keys were typed.
+  const bool prune = depth + 1 >= ngram_length;
+  is_recombining = prune && paths_per_state > 0;
+
+  costs.resize(n_symbols);
+
+  if (max_checkpoints > 0) {
+    // The best paths are replaced while typing, keep them for the checkpoint.
+    checkpoints.emplace_back();
+    checkpoints.back().best.swap(best);
+    checkpoints.back().history_size = history_symbols.size();
+    best.reserve(max_paths + 1);
+  }
+  best.clear();
+
+  if (!prune) {
+    size_t first_position = history_symbols.size();
+
+    next_scores.resize(n_rows * n_symbols);
+    next_contexts.resize(n_rows * n_symbols * context_size);
+    next_positions.resize(n_rows * n_symbols);
+    history_symbols.resize(first_position + n_rows * n_symbols);
+    history_parents.resize(first_position + n_rows * n_symbols);
+
+    for (size_t row = 0; row < n_rows; row++) {
+      const t9_symbol_id *context = contexts.data() + row * context_size;
+      language_model->conditional_costs(
+          t9_symbol_id_view(context + context_size - context_length, context_length), costs);
+
+      for (size_t symbol = 0; symbol < n_symbols; symbol++) {
+        size_t id = row * n_symbols + symbol;
+        float score = key_costs[symbol] + costs[symbol] + scores[row];
+
+        // Shift the symbol into the context of the new hypothesis.
+        t9_symbol_id *next_context = next_contexts.data() + id * context_size;
+        for (size_t position = 0; position + 1 < context_size; position++) {
+          next_context[position] = context[position + 1];
+        }
+        if (context_size > 0) {
+          next_context[context_size - 1] = static_cast<t9_symbol_id>(symbol);
+        }
+
+        next_scores[id] = score;
+        next_positions[id] = first_position + id;
+        history_symbols[first_position + id] = static_cast<t9_symbol_id>(symbol);
+        history_parents[first_position + id] = positions[row];
+
+        if (!is_rejected(score)) {
+          offer(score, id);
+        }
+      }
+    }
+
+    // Every candidate became a row, its identifier is its row.
+    std::sort_heap(best.begin(), best.end());
+  } else {
+    // The paths are still unique in their last (ngram_length - 1) symbols before, hence hypotheses are only recombined
+    // once pruning starts.
+    if (is_recombining) {
+      row_classes.resize(n_rows);
+      suffix_classes.clear();
+      state_counts.clear();
+      state_worst.clear();
+    }
+
+    for (size_t row = 0; row < n_rows; row++) {
+      // Costs never decrease along a path, none of the candidates of a rejected hypothesis can be accepted.
+      if (is_rejected(scores[row])) {
+        continue;
+      }
+
+      // Rows are only classified once one of their candidates is offered.
+      bool is_classified = false;
+
+      const t9_symbol_id *context = contexts.data() + row * context_size;
+      language_model->conditional_costs(
+          t9_symbol_id_view(context + context_size - context_length, context_length), costs);
+
+      for (size_t symbol = 0; symbol < n_symbols; symbol++) {
+        float score = key_costs[symbol] + costs[symbol] + scores[row];
+
+        if (is_rejected(score)) {
+          continue;
+        }
+
+        if (is_recombining) {
+          if (!is_classified) {
+            classify_row(row, n_symbols);
+            is_classified = true;
+          }
+          offer_recombined(score, row * n_symbols + symbol, n_symbols);
+        } else {
+          offer(score, row * n_symbols + symbol);
+        }
+      }
+    }
+
+    if (!is_recombining) {
+      std::sort_heap(best.begin(), best.end());
+    }
+
+    // Only the best candidates survive. Their rows keep the order of the candidates.
+    survivors.resize(best.size());
+    for (size_t index = 0; index < best.size(); index++) {
+      survivors[index] = index;
+    }
+    std::sort(survivors.begin(), survivors.end(), [this](size_t a, size_t b) {
+      return best[a].id < best[b].id;
+    });
+
+    next_scores.resize(survivors.size());
+    next_contexts.resize(survivors.size() * context_size);
+    next_positions.resize(survivors.size());
+
+    for (size_t next_row = 0; next_row < survivors.size(); next_row++) {
+      Candidate &candidate = best[survivors[next_row]];
+      size_t row = candidate.id / n_symbols;
+      auto symbol = static_cast<t9_symbol_id>(candidate.id % n_symbols);
+
+      const t9_symbol_id *context = contexts.data() + row * context_size;
+      t9_symbol_id *next_context = next_contexts.data() + next_row * context_size;
+      for (size_t position = 0; position + 1 < context_size; position++) {
+        next_context[position] = context[position + 1];
+      }
+      if (context_size > 0) {
+        next_context[context_size - 1] = symbol;
+      }
+
+      next_scores[next_row] = candidate.score;
+      next_positions[next_row] = history_symbols.size();
+      history_symbols.push_back(symbol);
+      history_parents.push_back(positions[row]);
+
+      candidate.id = next_row;
+    }
+  }
+
+  if (max_checkpoints > 0) {
+    // Move the replaced rows into the checkpoint instead of reusing them as buffers of the next expansion.
+    Checkpoint &checkpoint = checkpoints.back();
+    checkpoint.scores.swap(scores);
+    checkpoint.contexts.swap(contexts);
+    checkpoint.positions.swap(positions);
+
+    if (checkpoints.size() > max_checkpoints) {
+      checkpoints.pop_front();
+    }
+  }
+
+  scores.swap(next_scores);
+  contexts.swap(next_contexts);
+  positions.swap(next_positions);
+  depth++;
+
+  if (history_symbols.size() >= history_limit) {
+    compact_history();
+    history_limit = std::max<size_t>(T9_BEAM_MIN_HISTORY_LIMIT, 2 * history_symbols.size());
+  }
+}
+
+bool
+BeamDecoder::erase() {
+  if (checkpoints.empty()) {
+    return false;
+  }
+
+  Checkpoint &checkpoint = checkpoints.back();
+  scores.swap(checkpoint.scores);
+  contexts.swap(checkpoint.contexts);
+  positions.swap(checkpoint.positions);
+  best.swap(checkpoint.best);
+
+  // Symbols appended to the history by the erased key are no longer referenced.
+  history_symbols.resize(checkpoint.history_size);
+  history_parents.resize(checkpoint.history_size);
+
+  checkpoints.pop_back();
+  depth--;
+  return true;
+}
+
+void
+BeamDecoder::best_paths(std::vector<std::pair<t9_symbol_id_sequence, float>> &paths) const {
+  paths.clear();
+
+  for (const Candidate &candidate : best) {
+    t9_symbol_id_sequence sequence;
+
+    // Follow the backpointers through the history and reverse the collected symbols.
+    for (size_t position = positions[candidate.id]; position != T9_BEAM_NO_PARENT;
+         position = history_parents[position]) {
+      sequence.push_back(history_symbols[position]);
+    }
+    std::reverse(sequence.begin(), sequence.end());
+
+    paths.emplace_back(std::move(sequence), candidate.score);
+  }
+}
+
+size_t
+BeamDecoder::size() const {
+  return scores.size();
+}
+
+size_t
+BeamDecoder::n_checkpoints() const {
+  return checkpoints.size();
+}
+
+size_t
+BeamDecoder::history_size() const {
+  return history_symbols.size();
+}
+
+void
+BeamDecoder::compact_history() {
+  // Mark the symbols on the paths of the rows and the checkpoints, each path is followed until a marked symbol.
+  history_positions.assign(history_symbols.size(), T9_BEAM_NO_PARENT);
+  auto mark = [this](const std::vector<size_t> &row_positions) {
+    for (size_t position : row_positions) {
+      while (position != T9_BEAM_NO_PARENT && history_positions[position] == T9_BEAM_NO_PARENT) {
+        history_positions[position] = 0;
+        position = history_parents[position];
+      }
+    }
+  };
+  mark(positions);
+  for (const Checkpoint &checkpoint : checkpoints) {
+    mark(checkpoint.positions);
+  }
+
+  // Move the marked symbols to the front. Parents precede their children, hence they are already moved.
+  size_t n_kept = 0;
+  size_t next_checkpoint = 0;
+  for (size_t position = 0; position < history_symbols.size(); position++) {
+    // The history sizes of the checkpoints grow from the oldest to the latest checkpoint.
+    while (next_checkpoint < checkpoints.size() && checkpoints[next_checkpoint].history_size == position) {
+      checkpoints[next_checkpoint++].history_size = n_kept;
+    }
+
+    if (history_positions[position] != T9_BEAM_NO_PARENT) {
+      size_t parent = history_parents[position];
+      history_positions[position] = n_kept;
+      history_symbols[n_kept] = history_symbols[position];
+      history_parents[n_kept] = parent == T9_BEAM_NO_PARENT ? T9_BEAM_NO_PARENT : history_positions[parent];
+      n_kept++;
+    }
+  }
+  while (next_checkpoint < checkpoints.size()) {
+    checkpoints[next_checkpoint++].history_size = n_kept;
+  }
+  history_symbols.resize(n_kept);
+  history_parents.resize(n_kept);
+
+  // Point the rows to the moved symbols.
+  auto relocate = [this](std::vector<size_t> &row_positions) {
+    for (size_t &position : row_positions) {
+      if (position != T9_BEAM_NO_PARENT) {
+        position = history_positions[position];
+      }
+    }
+  };
+  relocate(positions);
+  for (Checkpoint &checkpoint : checkpoints) {
+    relocate(checkpoint.positions);
+  }
+}
+
+void
+BeamDecoder::offer(float score, size_t id) {
+  best.push_back({score, id});
+  std::push_heap(best.begin(), best.end());
+
+  if (best.size() > max_paths) {
+    // Drop the worst candidate.
+    std::pop_heap(best.begin(), best.end());
+    best.pop_back();
+  }
+}
+
+void
+BeamDecoder::offer_recombined(float score, size_t id, size_t n_symbols) {
+  Candidate candidate{score, id};
+  size_t state = state_of(id, n_symbols);
+
+  if (state_counts[state] >= paths_per_state) {
+    // The candidate replaces the worst path of its state, if it is better.
+    if (!(candidate < state_worst[state])) {
+      return;
+    }
+    best.erase(std::lower_bound(best.begin(), best.end(), state_worst[state]));
+    state_counts[state]--;
+
+    // Find the new worst path of the state, the candidate is compared below.
+    state_worst[state] = candidate;
+    for (auto path = best.rbegin(); path != best.rend() && paths_per_state > 1; path++) {
+      if (state_of(path->id, n_symbols) == state) {
+        state_worst[state] = std::max(*path, candidate);
+        break;
+      }
+    }
+  } else if (best.size() >= max_paths) {
+    // The candidate replaces the worst path of all. The worst path of its state is then the path before it, if any.
+    size_t worst_state = state_of(best.back().id, n_symbols);
+    best.pop_back();
+    if (--state_counts[worst_state] > 0) {
+      for (auto path = best.rbegin(); path != best.rend(); path++) {
+        if (state_of(path->id, n_symbols) == worst_state) {
+          state_worst[worst_state] = *path;
+          break;
+        }
+      }
+    }
+  }
+
+  if (state_counts[state] == 0 || state_worst[state] < candidate) {
+    state_worst[state] = candidate;
+  }
+  best.insert(std::upper_bound(best.begin(), best.end(), candidate), candidate);
+  state_counts[state]++;
+}
+
+void
+BeamDecoder::classify_row(size_t row, size_t n_symbols) {
+  const size_t context_size = ngram_length - 1;
+  const t9_symbol_id *context = contexts.data() + row * context_size;
+
+  // The oldest symbol of the context drops out when the symbol of a candidate is shifted in.
+  suffix.clear();
+  if (context_size > 0) {
+    suffix.append(context + 1, context_size - 1);
+  }
+
+  auto [suffix_class, is_new] = suffix_classes.emplace(suffix, suffix_classes.size());
+  if (is_new) {
+    state_counts.resize(state_counts.size() + n_symbols, 0);
+    state_worst.resize(state_counts.size());
+  }
+  row_classes[row] = suffix_class->second;
+}
+
+}  // namespace t9
@@ -0,0 +1,229 @@
+// T9 bloom filter -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#include "t9/bloom.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+#include "format.hpp"
+
+// Maximal number of bits set per sequence.
+#define T9_BLOOM_MAX_HASHES 16
+
+namespace t9 {
+
+BloomFilter::BloomFilter(size_t n_sequences, float false_positive_rate) : n_blocks(1), n_hashes(1) {
+  if (!(false_positive_rate > 0.0f && false_positive_rate < 1.0f)) {
+    std::string error_msg = format("Failed to build bloom filter: The false positive rate has to be within (0, 1).");
+    throw std::runtime_error(error_msg);
+  }
+
+  // Optimal number of bits and hashes of a standard bloom filter with the requested false positive rate.
+  double ln_2 = std::log(2.0);
+  double n_bits = -static_cast<double>(n_sequences) * std::log(false_positive_rate) / (ln_2 * ln_2);
+  n_blocks = std::max<size_t>(1, static_cast<size_t>(std::ceil(n_bits / T9_BLOOM_BLOCK_BITS)));
+  n_hashes = static_cast<size_t>(std::lround(-std::log2(false_positive_rate)));
+  n_hashes = std::clamp<size_t>(n_hashes, 1, T9_BLOOM_MAX_HASHES);
+
+  bits.assign(n_blocks * (T9_BLOOM_BLOCK_BITS / 64), 0);
+}
+
+void
+BloomFilter::insert(t9_symbol_id_view sequence) {
+  uint64_t value = hash(sequence);
+  uint64_t *block = bits.data() + (value % n_blocks) * (T9_BLOOM_BLOCK_BITS / 64);
+  uint64_t position = (value >> 32) % T9_BLOOM_BLOCK_BITS;
+  uint64_t step = ((value >> 41) % T9_BLOOM_BLOCK_BITS) | 1u;
+
+  for (size_t index = 0; index < n_hashes; index++) {
+    block[position / 64] |= uint64_t(1) << (position % 64);
+    position = (position + step) % T9_BLOOM_BLOCK_BITS;
+  }
+}
+
+bool
+BloomFilter::might_contain(t9_symbol_id_view sequence) const {
+  uint64_t value = hash(sequence);
+  const uint64_t *block = bits.data() + (value % n_blocks) * (T9_BLOOM_BLOCK_BITS / 64);
+  uint64_t position = (value >> 32) % T9_BLOOM_BLOCK_BITS;
+  uint64_t step = ((value >> 41) % T9_BLOOM_BLOCK_BITS) | 1u;
+
+  for (size_t index = 0; index < n_hashes; index++) {
+    if ((block[position / 64] & (uint64_t(1) << (position % 64))) == 0) {
+      return false;
+    }
+    position = (position + step) % T9_BLOOM_BLOCK_BITS;
+  }
+
+  return true;
+}
+
+size_t
+BloomFilter::memory_usage() const {
+  return bits.size() * sizeof(uint64_t);
+}
+
+uint64_t
+BloomFilter::hash(t9_symbol_id_view sequence) {
+  // FNV-1a over the symbols, followed by a finalizer mixing all bits.
+  uint64_t value = 0xCBF29CE484222325ull;
+  for (auto symbol : sequence) {
+    value = (value ^ symbol) * 0x100000001B3ull;
+  }
+
+  value ^= value >> 33;
+  value *= 0xFF51AFD7ED558CCDull;
+  value ^= value >> 33;
+  value *= 0xC4CEB9FE1A85EC53ull;
+  value ^= value >> 33;
+
+  return value;
+}
+
+BloomFilteredModel::BloomFilteredModel(const FrozenCorpusTree *tree, float false_positive_rate)
+    : tree(tree),
+      filter(tree->size() - 1, false_positive_rate),
+      n_checked(0),
+      n_rejected(0),
+      n_false_positives(0) {
+  std::vector<std::pair<uint32_t, size_t>> stack;
+  t9_symbol_id_sequence path;
+
+  // Insert the path of every node below the root into the filter (depth first).
+  stack.emplace_back(0, 0);
+  while (!stack.empty()) {
+    auto [node, level] = stack.back();
+    stack.pop_back();
+
+    if (level > 0) {
+      path.resize(level);
+      path[level - 1] = tree->symbols[node];
+      filter.insert(path);
+    }
+
+    for (uint32_t child = tree->first_child[node]; child < tree->first_child[node + 1]; child++) {
+      stack.emplace_back(child, level + 1);
+    }
+  }
+}
+
+BloomFilteredModel::~BloomFilteredModel() {
+  delete tree;
+}
+
+float
+BloomFilteredModel::conditional_probability(t9_symbol_id_view sequence) const {
+  if (!check(sequence)) {
+    return 0.0f;
+  }
+
+  float probability = tree->conditional_probability(sequence);
+  if (probability == 0.0f) {
+    n_false_positives++;
+  }
+
+  return probability;
+}
+
+float
+BloomFilteredModel::conditional_cost(t9_symbol_id_view sequence) const {
+  if (!check(sequence)) {
+    return tree->unseen_cost();
+  }
+
+  float cost = tree->conditional_cost(sequence);
+  if (cost == tree->unseen_cost()) {
+    n_false_positives++;
+  }
+
+  return cost;
+}
+
+void
+BloomFilteredModel::conditional_costs(t9_symbol_id_view context, std::vector<float> &costs) const {
+  // All sequences starting with an unseen context are unseen as well.
+  if (!context.empty() && !check(context)) {
+    std::fill(costs.begin(), costs.end(), tree->unseen_cost());
+    return;
+  }
+
+  tree->conditional_costs(context, costs);
+  if (!context.empty()
+      && std::all_of(costs.begin(), costs.end(), [this](float cost) { return cost == tree->unseen_cost(); })) {
+    n_false_positives++;
+  }
+}
+
+void
+BloomFilteredModel::conditional_cost_batch(const std::vector<t9_symbol_id_view> &sequences,
+                                           std::vector<float> &costs) const {
+  std::vector<t9_symbol_id_view> candidates;
+  std::vector<size_t> candidate_indices;
+  std::vector<float> candidate_costs;
+
+  costs.assign(sequences.size(), tree->unseen_cost());
+
+  // Only forward the sequences that pass the filter to the tree.
+  for (size_t index = 0; index < sequences.size(); index++) {
+    if (check(sequences[index])) {
+      candidates.push_back(sequences[index]);
+      candidate_indices.push_back(index);
+    }
+  }
+
+  tree->conditional_cost_batch(candidates, candidate_costs);
+  for (size_t candidate = 0; candidate < candidates.size(); candidate++) {
+    if (candidate_costs[candidate] == tree->unseen_cost()) {
+      n_false_positives++;
+    }
+    costs[candidate_indices[candidate]] = candidate_costs[candidate];
+  }
+}
+
+size_t
+BloomFilteredModel::memory_usage() const {
+  return tree->memory_usage() + filter.memory_usage();
+}
+
+size_t
+BloomFilteredModel::filter_memory_usage() const {
+  return filter.memory_usage();
+}
+
+size_t
+BloomFilteredModel::n_lookups() const {
+  return n_checked;
+}
+
+float
+BloomFilteredModel::hit_rate() const {
+  return n_checked == 0 ? 0.0f : static_cast<float>(n_rejected) / static_cast<float>(n_checked);
+}
+
+float
+BloomFilteredModel::false_positive_rate() const {
+  size_t n_unseen = n_rejected + n_false_positives;
+  return n_unseen == 0 ? 0.0f : static_cast<float>(n_false_positives) / static_cast<float>(n_unseen);
+}
+
+bool
+BloomFilteredModel::check(t9_symbol_id_view sequence) const {
+  n_checked++;
+
+  if (!filter.might_contain(sequence)) {
+    n_rejected++;
+    return false;
+  }
+
+  return true;
+}
+
+}  // namespace t9
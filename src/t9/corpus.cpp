@@ -8,53 +8,83 @@
 
 #include "t9/corpus.hpp"
 
+#include <algorithm>
+
 namespace t9 {
 Corpus::Corpus(const std::filesystem::path &train_file_path, size_t n_train,
                const std::filesystem::path &test_file_path, size_t n_test,
-               const std::unordered_map<t9_symbol, t9_symbol_sequence> &keyboard)
-    : key_2_corpus_map(keyboard) {
-
-  std::unordered_set<t9_symbol> train_data_set;
-  std::unordered_set<t9_symbol> test_data_set;
+               const std::unordered_map<t9_symbol, t9_symbol_sequence> &keyboard,
+               size_t train_chunk_size)
+    : train_file_path(train_file_path),
+      n_train(n_train),
+      train_chunk_size(train_chunk_size) {
+  t9_symbol_sequence train_text;
   bool symbols_valid;
 
-  // Construct the key set and the corpus symbol set.
-  for (auto const &[key, value] : key_2_corpus_map) {
-    // Update the the t9 key set.
-    keys_set.insert(key);
+  key_ids.fill(T9_INVALID_SYMBOL_ID);
+  symbol_ids.fill(T9_INVALID_SYMBOL_ID);
+
+  // Collect the unique keys and corpus symbols.
+  for (auto const &[key, value] : keyboard) {
+    id_keys.push_back(key);
+    id_symbols.insert(id_symbols.end(), value.begin(), value.end());
+  }
+  std::sort(id_keys.begin(), id_keys.end());
+  id_keys.erase(std::unique(id_keys.begin(), id_keys.end()), id_keys.end());
+  std::sort(id_symbols.begin(), id_symbols.end());
+  id_symbols.erase(std::unique(id_symbols.begin(), id_symbols.end()), id_symbols.end());
+
+  if (id_keys.size() >= T9_INVALID_SYMBOL_ID || id_symbols.size() >= T9_INVALID_SYMBOL_ID) {
+    std::string error_msg = format("The keyboard defines too many keys or corpus symbols.");
+    throw std::runtime_error(error_msg);
+  }
+
+  // Assign dense identifiers to the keys and corpus symbols in ascending order.
+  for (size_t id = 0; id < id_keys.size(); id++) {
+    auto index = static_cast<unsigned char>(id_keys[id]);
+    key_ids[index] = static_cast<t9_symbol_id>(id);
+    key_mask.set(index);
+  }
+  for (size_t id = 0; id < id_symbols.size(); id++) {
+    auto index = static_cast<unsigned char>(id_symbols[id]);
+    symbol_ids[index] = static_cast<t9_symbol_id>(id);
+    symbol_mask.set(index);
+  }
 
-    // Update the corpus symbol set and.
-    // populate the reverse corpus_2_key_map table.
+  // Populate the key to corpus symbols and the reverse corpus symbol to key tables.
+  key_symbols.resize(id_keys.size());
+  symbol_keys.resize(id_symbols.size(), T9_INVALID_SYMBOL_ID);
+  for (auto const &[key, value] : keyboard) {
+    key_symbols[key_id(key)] = value;
     for (auto symbol : value) {
-      corpus_set.insert(symbol);
-      corpus_2_key_map[symbol] = key;
+      symbol_keys[symbol_id(symbol)] = key_id(key);
     }
   }
 
-  // Load the train data.
-  train_data = t9::io::load_text_file(train_file_path, n_train);
-  std::cout << "Loaded train data (" << train_data.size() << " bytes)" << std::endl;
-
-  // Construct a set of symbols contained in the train data.
-  train_data_set = construct_set_from_sequence(train_data);
-//  std::cout << "Unique symbols found " << train_data_set.size() << std::endl;
+  if (is_streamed()) {
+    // The train data is validated chunk by chunk while it is streamed.
+    std::cout << "Streaming train data in chunks of " << train_chunk_size << " bytes" << std::endl;
+  } else {
+    // Load the train data.
+    train_text = t9::io::load_text_file(train_file_path, n_train);
+    std::cout << "Loaded train data (" << train_text.size() << " bytes)" << std::endl;
+
+    // Check if the loaded train data only contains valid symbols.
+    symbols_valid = validate_corpus_symbols(train_text);
+    if (!symbols_valid) {
+      std::string error_msg = format("The train data contains invalid symbols.");
+      throw std::runtime_error(error_msg);
+    }
+    std::cout << "Train data validated successfully" << std::endl;
 
-  // Check if the loaded train data only contains valid symbols.
-  symbols_valid = validate_corpus_symbols(train_data);
-  if (!symbols_valid) {
-    std::string error_msg = format("The train data contains invalid symbols.");
-    throw std::runtime_error(error_msg);
+    // Only the symbol identifiers of the train data are kept.
+    train_data = encode_symbols(train_text);
   }
-  std::cout << "Train data validated successfully" << std::endl;
 
   // Load the test data.
   test_data = t9::io::load_text_file(test_file_path, n_test);
   std::cout << "Loaded test data (" << test_data.size() << " bytes)" << std::endl;
 
-  // Construct a set of symbols contained in the test data.
-  test_data_set = construct_set_from_sequence(test_data);
-//  std::cout << "Unique symbols found " << test_data_set.size() << std::endl;
-
   // Check if the loaded test data only contains valid symbols.
   symbols_valid = validate_corpus_symbols(test_data);
   if (!symbols_valid) {
@@ -66,42 +96,38 @@ Corpus::Corpus(const std::filesystem::path &train_file_path, size_t n_train,
 
 const t9_symbol_sequence &
 Corpus::ktoc(t9_symbol key) const {
-  // Search for the key.
-  auto corpus_symbol = key_2_corpus_map.find(key);
+  t9_symbol_id id = key_id(key);
 
-  if (corpus_symbol != key_2_corpus_map.end()) {
-    // The key was found, return the corresponding corpus symbols.
-    return corpus_symbol->second;
-  } else {
+  if (id == T9_INVALID_SYMBOL_ID) {
     // The passed key is unknown.
     std::string error_msg = format("Failed to find key \"%c\": No such key in the lookup table.", key);
     throw std::runtime_error(error_msg);
   }
+
+  // The key was found, return the corresponding corpus symbols.
+  return key_symbols[id];
 }
 
 t9_symbol
 Corpus::ctok(t9_symbol corpus_symbol) const {
-  // Search for the corpus symbol.
-  auto key = corpus_2_key_map.find(corpus_symbol);
+  t9_symbol_id id = symbol_id(corpus_symbol);
 
-  if (key != corpus_2_key_map.end()) {
-    // The corpus symbols was found, return the corresponding key.
-    return key->second;
-  } else {
+  if (id == T9_INVALID_SYMBOL_ID) {
     // The passed corpus symbol is unknown.
     std::string error_msg = format(
-        "Failed to find corpus symbol \"%c\": No such symbol in the lookup table.", key);
+        "Failed to find corpus symbol \"%c\": No such symbol in the lookup table.", corpus_symbol);
     throw std::runtime_error(error_msg);
   }
+
+  // The corpus symbols was found, return the corresponding key.
+  return key(key_of_symbol(id));
 }
 
 bool
 Corpus::validate_t9_keys(const t9_symbol_sequence &keys) const {
   for (auto key : keys) {
     // Check if the key is a known (valid) key.
-    auto lookup = keys_set.find(key);
-
-    if (lookup == keys_set.end()) {
+    if (!key_mask.test(static_cast<unsigned char>(key))) {
       // The key was not found and hence is not a valid.
       return false;
     }
@@ -115,8 +141,7 @@ bool
 Corpus::validate_corpus_symbols(const t9_symbol_sequence &symbols) const {
   for (auto symbol : symbols) {
     // Check if the symbol is a known (valid) corpus symbol.
-    auto lookup = corpus_set.find(symbol);
-    if (lookup == corpus_set.end()) {
+    if (!symbol_mask.test(static_cast<unsigned char>(symbol))) {
       // The symbol was not found and hence is not a valid.
       return false;
     }
@@ -126,6 +151,42 @@ Corpus::validate_corpus_symbols(const t9_symbol_sequence &symbols) const {
   return true;
 }
 
+t9_symbol_id_sequence
+Corpus::encode_keys(const t9_symbol_sequence &keys) const {
+  t9_symbol_id_sequence ids;
+  ids.reserve(keys.size());
+
+  for (auto key : keys) {
+    ids.push_back(key_id(key));
+  }
+
+  return ids;
+}
+
+t9_symbol_id_sequence
+Corpus::encode_symbols(const t9_symbol_sequence &symbols) const {
+  t9_symbol_id_sequence ids;
+  ids.reserve(symbols.size());
+
+  for (auto symbol : symbols) {
+    ids.push_back(symbol_id(symbol));
+  }
+
+  return ids;
+}
+
+t9_symbol_sequence
+Corpus::decode_symbols(t9_symbol_id_view ids) const {
+  t9_symbol_sequence symbols;
+  symbols.reserve(ids.size());
+
+  for (auto id : ids) {
+    symbols.push_back(symbol(id));
+  }
+
+  return symbols;
+}
+
 size_t
 Corpus::sequence_diff(const t9_symbol_sequence &seq1,
                       const t9_symbol_sequence &seq2) const {
@@ -169,20 +230,64 @@ Corpus::keys_from_corpus(const t9_symbol_sequence &corpus_sequence) const {
   return keys;
 }
 
-std::unordered_set<t9_symbol>
-Corpus::construct_set_from_sequence(const t9_symbol_sequence &data) {
-  std::unordered_set<t9_symbol> symbol_set;
+const t9_symbol_id_sequence &
+Corpus::get_train_data() const {
+  return train_data;
+}
+
+bool
+Corpus::is_streamed() const {
+  return train_chunk_size > 0;
+}
 
-  for (auto symbol : data) {
-    symbol_set.insert(symbol);
+size_t
+Corpus::train_length() const {
+  if (!is_streamed()) {
+    return train_data.size();
   }
 
-  return symbol_set;
+  // Streamed train data is read up to n_train bytes of the file, like the train data held in memory is loaded.
+  size_t file_size = std::filesystem::file_size(train_file_path);
+  return n_train > 0 ? std::min(n_train, file_size) : file_size;
 }
 
-const t9_symbol_sequence &
-Corpus::get_train_data() const {
-  return train_data;
+void
+Corpus::stream_train_data(size_t overlap, const std::function<void(t9_symbol_id_view)> &consumer) const {
+  t9_symbol_sequence chunk;
+  t9_symbol_id_sequence window;
+
+  if (!is_streamed()) {
+    consumer(train_data);
+    return;
+  }
+
+  io::TextFileReader reader(train_file_path, n_train);
+  window.reserve(overlap + train_chunk_size);
+
+  while (!reader.is_done()) {
+    reader.read_chunk(chunk, train_chunk_size);
+
+    // Check if the chunk only contains valid symbols.
+    if (!validate_corpus_symbols(chunk)) {
+      std::string error_msg = format("The train data contains invalid symbols.");
+      throw std::runtime_error(error_msg);
+    }
+
+    // Carry over the end of the previous chunk and append the new one.
+    if (window.size() > overlap) {
+      window.erase(0, window.size() - overlap);
+    }
+    for (auto symbol : chunk) {
+      window.push_back(symbol_id(symbol));
+    }
+
+    consumer(window);
+  }
+}
+
+t9_symbol_sequence
+Corpus::get_alphabet() const {
+  return t9_symbol_sequence(id_symbols.begin(), id_symbols.end());
 }
 
 const t9_symbol_sequence &
@@ -0,0 +1,182 @@
+// T9 dense ngram table -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#include "t9/dense.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "format.hpp"
+#include "t9/generator.hpp"
+#include "t9/math.hpp"
+
+namespace t9 {
+
+namespace {
+/**
+ * Read a count stored in the bits of a table entry.
+ * @param entry Table entry holding a count instead of a cost.
+ * @return Count.
+ */
+uint32_t
+load_count(const float &entry) {
+  uint32_t count;
+  std::memcpy(&count, &entry, sizeof(uint32_t));
+  return count;
+}
+
+/**
+ * Store a count in the bits of a table entry.
+ * @param entry Table entry to overwrite.
+ * @param count Count.
+ */
+void
+store_count(float &entry, uint32_t count) {
+  std::memcpy(&entry, &count, sizeof(uint32_t));
+}
+}  // namespace
+
+DenseNGRAMTable::DenseNGRAMTable(const Corpus &corpus, size_t ngram_length)
+    : n_symbols(corpus.n_symbols()),
+      ngram_length(ngram_length),
+      unseen_cost(-t9::ln(0.0f)) {
+  uint64_t n_ngrams = 0;
+
+  if (ngram_length == 0 || required_memory(n_symbols, ngram_length) == std::numeric_limits<size_t>::max()) {
+    std::string error_msg = format("Failed to build dense ngram table: A table of %zu-grams can not be represented.",
+                                   ngram_length);
+    throw std::runtime_error(error_msg);
+  }
+
+  // Sequences of length k start behind all sequences that are shorter, offsets[ngram_length + 1] is the table size.
+  offsets.assign(ngram_length + 2, 0);
+  size_t n_sequences = 1;
+  for (size_t length = 1; length <= ngram_length; length++) {
+    n_sequences *= n_symbols;
+    offsets[length + 1] = offsets[length] + n_sequences;
+  }
+
+  // Count every prefix of every ngram, just like the corpus tree counts every node along the path of an ngram. The
+  // counts are kept in the bits of the cost entries, so building the table needs no memory beyond the table itself.
+  costs.assign(offsets.back(), 0.0f);
+  corpus.stream_train_data(ngram_length - 1, [this, ngram_length, &n_ngrams](t9_symbol_id_view chunk) {
+    t9::NGRAMGenerator generator(chunk, ngram_length);
+
+    while (!generator.is_done()) {
+      t9_symbol_id_view ngram = generator.generate_ngram();
+      size_t position = 0;
+
+      if (n_ngrams == T9_DENSE_MAX_NGRAMS) {
+        std::string error_msg = format("Failed to build dense ngram table: More than %u ngrams can not be counted.",
+                                       T9_DENSE_MAX_NGRAMS);
+        throw std::runtime_error(error_msg);
+      }
+
+      for (size_t length = 1; length <= ngram.size(); length++) {
+        position = position * n_symbols + ngram[length - 1];
+        float &entry = costs[offsets[length] + position];
+        store_count(entry, load_count(entry) + 1);
+      }
+      n_ngrams++;
+    }
+  });
+
+  // Replace the counts by the cost of each sequence given its context (the sequence without its last symbol). Longer
+  // sequences are converted first, as they still need the counts of their contexts.
+  for (size_t length = ngram_length; length >= 1; length--) {
+    for (size_t position = 0; position < offsets[length + 1] - offsets[length]; position++) {
+      float &entry = costs[offsets[length] + position];
+      uint32_t count = load_count(entry);
+      if (count == 0) {
+        entry = unseen_cost;
+        continue;
+      }
+
+      uint64_t context_count = length == 1 ? n_ngrams : load_count(costs[offsets[length - 1] + position / n_symbols]);
+      entry = -t9::ln(static_cast<float>(count) / static_cast<float>(context_count));
+    }
+  }
+}
+
+float
+DenseNGRAMTable::conditional_probability(t9_symbol_id_view sequence) const {
+  float cost = conditional_cost(sequence);
+  return cost == unseen_cost ? 0.0f : std::exp(-cost);
+}
+
+float
+DenseNGRAMTable::conditional_cost(t9_symbol_id_view sequence) const {
+  size_t position = 0;
+
+  if (sequence.empty() || sequence.size() > ngram_length) {
+    // Such a sequence is never stored in the table.
+    return unseen_cost;
+  }
+
+  for (auto symbol : sequence) {
+    if (symbol >= n_symbols) {
+      return unseen_cost;
+    }
+    position = position * n_symbols + symbol;
+  }
+
+  return costs[offsets[sequence.size()] + position];
+}
+
+void
+DenseNGRAMTable::conditional_costs(t9_symbol_id_view context, std::vector<float> &costs) const {
+  size_t position = 0;
+
+  if (context.size() >= ngram_length || costs.size() != n_symbols) {
+    // Fall back to one lookup per symbol.
+    LanguageModel::conditional_costs(context, costs);
+    return;
+  }
+
+  for (auto symbol : context) {
+    if (symbol >= n_symbols) {
+      std::fill(costs.begin(), costs.end(), unseen_cost);
+      return;
+    }
+    position = position * n_symbols + symbol;
+  }
+
+  // The costs of all symbols following a context are stored next to each other.
+  auto begin = this->costs.begin() + static_cast<std::ptrdiff_t>(offsets[context.size() + 1] + position * n_symbols);
+  std::copy(begin, begin + static_cast<std::ptrdiff_t>(n_symbols), costs.begin());
+}
+
+size_t
+DenseNGRAMTable::memory_usage() const {
+  return costs.size() * sizeof(float) + offsets.size() * sizeof(size_t);
+}
+
+size_t
+DenseNGRAMTable::required_memory(size_t n_symbols, size_t ngram_length) {
+  const size_t limit = std::numeric_limits<size_t>::max() / sizeof(float);
+  size_t n_sequences = 1;
+  size_t n_entries = 0;
+
+  for (size_t length = 1; length <= ngram_length; length++) {
+    if (n_symbols != 0 && n_sequences > limit / n_symbols) {
+      return std::numeric_limits<size_t>::max();
+    }
+    n_sequences *= n_symbols;
+
+    if (n_entries > limit - n_sequences) {
+      return std::numeric_limits<size_t>::max();
+    }
+    n_entries += n_sequences;
+  }
+
+  return n_entries * sizeof(float) + (ngram_length + 2) * sizeof(size_t);
+}
+
+}  // namespace t9
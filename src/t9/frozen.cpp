@@ -0,0 +1,500 @@
+// T9 frozen corpus tree -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#include "t9/frozen.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+
+#include "format.hpp"
+#include "t9/math.hpp"
+#include "t9/snapshot.hpp"
+#include "t9/tree.hpp"
+
+// Marker used to detect files written on a machine with a different byte order.
+#define T9_MODEL_FILE_BYTE_ORDER 0x01020304u
+
+// Node index marking a batched lookup whose sequence is not in the tree.
+#define T9_FROZEN_MISSING_NODE 0xFFFFFFFFu
+
+namespace t9 {
+
+namespace {
+/**
+ * Round a buffer offset up to the next multiple of 8 bytes.
+ * @param offset Offset in bytes.
+ * @return Aligned offset in bytes.
+ */
+uint64_t
+align_offset(uint64_t offset) {
+  return (offset + 7u) & ~static_cast<uint64_t>(7u);
+}
+
+/**
+ * Check if an array is located inside of a buffer and aligned for its elements.
+ * @tparam T Type of the array elements.
+ * @param offset Offset of the array in bytes.
+ * @param n_elements Number of elements of the array.
+ * @param size Size of the buffer in bytes.
+ * @return true if the array is valid, false otherwise.
+ */
+template<typename T>
+bool
+is_valid_array(uint64_t offset, uint64_t n_elements, size_t size) {
+  return offset % alignof(T) == 0 && offset <= size && n_elements <= (size - offset) / sizeof(T);
+}
+}  // namespace
+
+FrozenCorpusTree::FrozenCorpusTree(const CorpusTree &tree, const t9_symbol_sequence &alphabet)
+    : header(nullptr), n_nodes(0), symbols(nullptr), probabilities(nullptr), costs(nullptr), counts(nullptr),
+      first_child(nullptr) {
+  std::queue<std::pair<const CorpusNode *, size_t>> queue;
+  std::vector<const CorpusNode *> children;
+  std::vector<t9_symbol_id> node_symbols;
+  std::vector<float> node_probabilities;
+  std::vector<uint64_t> node_counts;
+  std::vector<uint32_t> node_first_child;
+  size_t tree_depth = 0;
+
+  // Traverse the tree in level order. Children are appended to the arrays in the order their parents are visited,
+  // therefore the children of each node end up in one contiguous range.
+  queue.push({tree.root, 0});
+  node_symbols.push_back(tree.root->symbol);
+  node_probabilities.push_back(tree.root->probability);
+  node_counts.push_back(tree.root->count);
+
+  while (!queue.empty()) {
+    auto [node, level] = queue.front();
+    queue.pop();
+    tree_depth = std::max(tree_depth, level);
+
+    if (node_symbols.size() > std::numeric_limits<uint32_t>::max()) {
+      std::string error_msg = format("Failed to freeze corpus tree: Too many nodes.");
+      throw std::runtime_error(error_msg);
+    }
+    node_first_child.push_back(static_cast<uint32_t>(node_symbols.size()));
+
+    // Sort the children by their symbol to allow searching them with a binary search.
+    children.assign(node->children.begin(), node->children.end());
+    std::sort(children.begin(), children.end(), [](const CorpusNode *a, const CorpusNode *b) {
+      return a->symbol < b->symbol;
+    });
+
+    for (const CorpusNode *child : children) {
+      node_symbols.push_back(child->symbol);
+      node_probabilities.push_back(child->probability);
+      node_counts.push_back(child->count);
+      queue.push({child, level + 1});
+    }
+  }
+
+  // Terminate the child ranges with a sentinel.
+  node_first_child.push_back(static_cast<uint32_t>(node_symbols.size()));
+
+  pack(node_symbols, node_probabilities, node_counts, node_first_child, tree_depth, alphabet);
+}
+
+FrozenCorpusTree::FrozenCorpusTree(CountSnapshot &snapshot)
+    : header(nullptr), n_nodes(0), symbols(nullptr), probabilities(nullptr), costs(nullptr), counts(nullptr),
+      first_child(nullptr) {
+  std::vector<size_t> level_sizes(snapshot.ngram_length() + 1, 0);
+  t9_symbol_id_sequence ngram;
+  t9_symbol_id_sequence last;
+  uint64_t count;
+  size_t tree_depth = 0;
+
+  // First pass: Count the nodes of each level. Each ngram shares the nodes of its common prefix with the previous one.
+  level_sizes[0] = 1;
+  snapshot.rewind();
+  while (snapshot.next(ngram, count)) {
+    size_t shared = 0;
+    while (shared < last.size() && ngram[shared] == last[shared]) {
+      shared++;
+    }
+
+    for (size_t level = shared; level < ngram.size(); level++) {
+      level_sizes[level + 1]++;
+    }
+    tree_depth = std::max(tree_depth, ngram.size());
+
+    last.swap(ngram);
+  }
+
+  // Nodes of the same level are stored next to each other, in the order they are visited.
+  std::vector<size_t> next_node(level_sizes.size() + 1, 0);
+  for (size_t level = 0; level < level_sizes.size(); level++) {
+    next_node[level + 1] = next_node[level] + level_sizes[level];
+  }
+  if (next_node.back() > std::numeric_limits<uint32_t>::max()) {
+    std::string error_msg = format("Failed to freeze corpus tree: Too many nodes.");
+    throw std::runtime_error(error_msg);
+  }
+
+  Header &layout = allocate(next_node.back(), tree_depth, snapshot.alphabet());
+  auto node_symbols = reinterpret_cast<t9_symbol_id *>(storage.data() + layout.symbols_offset);
+  auto node_probabilities = reinterpret_cast<float *>(storage.data() + layout.probabilities_offset);
+  auto node_costs = reinterpret_cast<float *>(storage.data() + layout.costs_offset);
+  auto node_counts = reinterpret_cast<uint64_t *>(storage.data() + layout.counts_offset);
+  auto node_first_child = reinterpret_cast<uint32_t *>(storage.data() + layout.first_child_offset);
+
+  // The children of a node are complete once the search leaves its subtree, normalize their counts then.
+  auto close_node = [&](size_t node, size_t level) {
+    uint64_t children_count = 0;
+    for (size_t child = node_first_child[node]; child < next_node[level + 1]; child++) {
+      children_count += node_counts[child];
+    }
+    for (size_t child = node_first_child[node]; child < next_node[level + 1]; child++) {
+      node_probabilities[child] = static_cast<float>(node_counts[child]) / static_cast<float>(children_count);
+      node_costs[child] = -t9::ln(node_probabilities[child]);
+    }
+  };
+
+  // Second pass: Write the nodes along the path of each ngram.
+  std::vector<size_t> path = {next_node[0]++};
+  node_symbols[0] = T9_INVALID_SYMBOL_ID;
+  node_costs[0] = -t9::ln(0.0f);
+  node_first_child[0] = static_cast<uint32_t>(next_node[1]);
+
+  last.clear();
+  snapshot.rewind();
+  while (snapshot.next(ngram, count)) {
+    size_t shared = 0;
+    while (shared < last.size() && ngram[shared] == last[shared]) {
+      shared++;
+    }
+
+    while (path.size() > shared + 1) {
+      close_node(path.back(), path.size() - 1);
+      path.pop_back();
+    }
+    for (size_t level = shared + 1; level <= ngram.size(); level++) {
+      size_t node = next_node[level]++;
+      node_symbols[node] = ngram[level - 1];
+      node_costs[node] = -t9::ln(0.0f);
+      node_first_child[node] = static_cast<uint32_t>(next_node[level + 1]);
+      path.push_back(node);
+    }
+
+    for (auto node : path) {
+      node_counts[node] += count;
+    }
+
+    last.swap(ngram);
+  }
+  while (!path.empty()) {
+    close_node(path.back(), path.size() - 1);
+    path.pop_back();
+  }
+
+  // Terminate the child ranges with a sentinel.
+  node_first_child[layout.n_nodes] = static_cast<uint32_t>(layout.n_nodes);
+
+  bind(storage.data(), storage.size());
+}
+
+FrozenCorpusTree::FrozenCorpusTree(const std::filesystem::path &file_path)
+    : header(nullptr), n_nodes(0), symbols(nullptr), probabilities(nullptr), costs(nullptr), counts(nullptr),
+      first_child(nullptr) {
+  mapping = std::make_unique<io::MappedFile>(file_path);
+  bind(mapping->data(), mapping->size());
+}
+
+void
+FrozenCorpusTree::thaw(CorpusTree &tree) const {
+  std::vector<CorpusNode *> nodes(n_nodes, nullptr);
+
+  // Nodes are stored in level order, hence each parent is created before its children.
+  nodes[0] = tree.root;
+  tree.root->count = counts[0];
+  for (size_t node = 0; node < n_nodes; node++) {
+    for (uint32_t child = first_child[node]; child < first_child[node + 1]; child++) {
+      nodes[child] = nodes[node]->get_child_safe(symbols[child]);
+      nodes[child]->count = counts[child];
+      nodes[node]->children_count += counts[child];
+      nodes[child]->probability = probabilities[child];
+    }
+  }
+}
+
+void
+FrozenCorpusTree::save(const std::filesystem::path &file_path) const {
+  io::save_binary_file(file_path, header, header->size);
+}
+
+float
+FrozenCorpusTree::conditional_probability(t9_symbol_id_view sequence) const {
+  uint32_t node = 0;
+
+  // Descend the tree one symbol at a time.
+  for (auto symbol : sequence) {
+    node = find_child(node, symbol);
+    if (node == 0) {
+      // Sequence is not in tree.
+      return 0.0f;
+    }
+  }
+
+  return probabilities[node];
+}
+
+float
+FrozenCorpusTree::conditional_cost(t9_symbol_id_view sequence) const {
+  uint32_t node = 0;
+
+  // Descend the tree one symbol at a time.
+  for (auto symbol : sequence) {
+    node = find_child(node, symbol);
+    if (node == 0) {
+      // Sequence is not in tree.
+      return header->unseen_cost;
+    }
+  }
+
+  return costs[node];
+}
+
+void
+FrozenCorpusTree::conditional_costs(t9_symbol_id_view context, std::vector<float> &costs) const {
+  uint32_t node = 0;
+
+  std::fill(costs.begin(), costs.end(), header->unseen_cost);
+
+  // Descend the tree to the context node.
+  for (auto symbol : context) {
+    node = find_child(node, symbol);
+    if (node == 0) {
+      // Context is not in tree.
+      return;
+    }
+  }
+
+  for (uint32_t child = first_child[node]; child < first_child[node + 1]; child++) {
+    if (symbols[child] < costs.size()) {
+      costs[symbols[child]] = this->costs[child];
+    }
+  }
+}
+
+void
+FrozenCorpusTree::conditional_cost_batch(const std::vector<t9_symbol_id_view> &sequences,
+                                         std::vector<float> &costs) const {
+  std::vector<uint32_t> nodes(sequences.size(), 0);
+  size_t max_length = 0;
+
+  for (const auto &sequence : sequences) {
+    max_length = std::max(max_length, sequence.size());
+  }
+
+  for (size_t level = 0; level < max_length; level++) {
+    // Stage 1: The child ranges of the current nodes are known, prefetch the symbols that are searched in stage 2.
+    for (size_t index = 0; index < sequences.size(); index++) {
+      if (level < sequences[index].size() && nodes[index] != T9_FROZEN_MISSING_NODE) {
+        __builtin_prefetch(symbols + first_child[nodes[index]]);
+      }
+    }
+
+    // Stage 2: Search the children and prefetch the child ranges of the next level.
+    for (size_t index = 0; index < sequences.size(); index++) {
+      if (level < sequences[index].size() && nodes[index] != T9_FROZEN_MISSING_NODE) {
+        uint32_t child = find_child(nodes[index], sequences[index][level]);
+
+        if (child == 0) {
+          // Sequence is not in tree.
+          nodes[index] = T9_FROZEN_MISSING_NODE;
+        } else {
+          nodes[index] = child;
+          if (level + 1 < sequences[index].size()) {
+            __builtin_prefetch(first_child + child);
+          } else {
+            __builtin_prefetch(this->costs + child);
+          }
+        }
+      }
+    }
+  }
+
+  costs.resize(sequences.size());
+  for (size_t index = 0; index < sequences.size(); index++) {
+    costs[index] = nodes[index] == T9_FROZEN_MISSING_NODE ? header->unseen_cost : this->costs[nodes[index]];
+  }
+}
+
+float
+FrozenCorpusTree::unseen_cost() const {
+  return header->unseen_cost;
+}
+
+size_t
+FrozenCorpusTree::size() const {
+  return n_nodes;
+}
+
+size_t
+FrozenCorpusTree::memory_usage() const {
+  return header->size;
+}
+
+size_t
+FrozenCorpusTree::depth() const {
+  return header->depth;
+}
+
+t9_symbol_sequence
+FrozenCorpusTree::alphabet() const {
+  return t9_symbol_sequence(header->alphabet, header->n_symbols);
+}
+
+size_t
+FrozenCorpusTree::buffer_size(size_t n_nodes) {
+  Header layout{};
+
+  layout_buffer(layout, n_nodes);
+  return layout.size;
+}
+
+void
+FrozenCorpusTree::layout_buffer(Header &layout, size_t n_nodes) {
+  layout.symbols_offset = align_offset(sizeof(Header));
+  layout.probabilities_offset = align_offset(layout.symbols_offset + n_nodes * sizeof(t9_symbol_id));
+  layout.costs_offset = align_offset(layout.probabilities_offset + n_nodes * sizeof(float));
+  layout.counts_offset = align_offset(layout.costs_offset + n_nodes * sizeof(float));
+  layout.first_child_offset = align_offset(layout.counts_offset + n_nodes * sizeof(uint64_t));
+  layout.size = align_offset(layout.first_child_offset + (n_nodes + 1) * sizeof(uint32_t));
+}
+
+FrozenCorpusTree::Header &
+FrozenCorpusTree::allocate(size_t n_nodes, size_t tree_depth, const t9_symbol_sequence &alphabet) {
+  Header layout{};
+
+  if (alphabet.size() > sizeof(layout.alphabet)) {
+    std::string error_msg = format("Failed to freeze corpus tree: The alphabet contains too many symbols.");
+    throw std::runtime_error(error_msg);
+  }
+
+  // Describe the layout of the buffer.
+  std::memcpy(layout.magic, T9_MODEL_FILE_MAGIC, sizeof(layout.magic));
+  layout.version = T9_MODEL_FILE_VERSION;
+  layout.byte_order = T9_MODEL_FILE_BYTE_ORDER;
+  layout.n_nodes = n_nodes;
+  layout.depth = tree_depth;
+  layout.n_symbols = alphabet.size();
+  std::memcpy(layout.alphabet, alphabet.data(), alphabet.size());
+  layout.unseen_cost = -t9::ln(0.0f);
+  layout_buffer(layout, n_nodes);
+
+  storage.assign(layout.size, 0);
+  std::memcpy(storage.data(), &layout, sizeof(Header));
+
+  return *reinterpret_cast<Header *>(storage.data());
+}
+
+void
+FrozenCorpusTree::pack(const std::vector<t9_symbol_id> &node_symbols,
+                       const std::vector<float> &node_probabilities,
+                       const std::vector<uint64_t> &node_counts,
+                       const std::vector<uint32_t> &node_first_child,
+                       size_t tree_depth,
+                       const t9_symbol_sequence &alphabet) {
+  size_t count = node_symbols.size();
+  Header &layout = allocate(count, tree_depth, alphabet);
+
+  // Copy the node arrays into the buffer.
+  std::memcpy(storage.data() + layout.symbols_offset, node_symbols.data(), count * sizeof(t9_symbol_id));
+  std::memcpy(storage.data() + layout.probabilities_offset, node_probabilities.data(), count * sizeof(float));
+  for (size_t node = 0; node < count; node++) {
+    float cost = -t9::ln(node_probabilities[node]);
+    std::memcpy(storage.data() + layout.costs_offset + node * sizeof(float), &cost, sizeof(float));
+  }
+  std::memcpy(storage.data() + layout.counts_offset, node_counts.data(), count * sizeof(uint64_t));
+  std::memcpy(storage.data() + layout.first_child_offset, node_first_child.data(), (count + 1) * sizeof(uint32_t));
+
+  bind(storage.data(), storage.size());
+}
+
+void
+FrozenCorpusTree::bind(const uint8_t *data, size_t size) {
+  if (size < sizeof(Header)) {
+    std::string error_msg = format("Failed to load corpus tree: The buffer is too small.");
+    throw std::runtime_error(error_msg);
+  }
+
+  if (reinterpret_cast<uintptr_t>(data) % alignof(Header) != 0) {
+    std::string error_msg = format("Failed to load corpus tree: The buffer is not aligned.");
+    throw std::runtime_error(error_msg);
+  }
+
+  header = reinterpret_cast<const Header *>(data);
+
+  if (std::memcmp(header->magic, T9_MODEL_FILE_MAGIC, sizeof(header->magic)) != 0) {
+    std::string error_msg = format("Failed to load corpus tree: Not a model file.");
+    throw std::runtime_error(error_msg);
+  }
+
+  if (header->version != T9_MODEL_FILE_VERSION) {
+    std::string error_msg = format("Failed to load corpus tree: Unsupported format version %u (expected %u).",
+                                   header->version, T9_MODEL_FILE_VERSION);
+    throw std::runtime_error(error_msg);
+  }
+
+  if (header->byte_order != T9_MODEL_FILE_BYTE_ORDER) {
+    std::string error_msg = format("Failed to load corpus tree: The model was written with a different byte order.");
+    throw std::runtime_error(error_msg);
+  }
+
+  // Make sure all arrays are located inside of the buffer and aligned.
+  n_nodes = header->n_nodes;
+  if (header->size > size
+      || n_nodes == 0
+      || n_nodes > std::numeric_limits<uint32_t>::max()
+      || header->n_symbols > sizeof(header->alphabet)
+      || !is_valid_array<t9_symbol_id>(header->symbols_offset, n_nodes, size)
+      || !is_valid_array<float>(header->probabilities_offset, n_nodes, size)
+      || !is_valid_array<float>(header->costs_offset, n_nodes, size)
+      || !is_valid_array<uint64_t>(header->counts_offset, n_nodes, size)
+      || !is_valid_array<uint32_t>(header->first_child_offset, n_nodes + 1, size)) {
+    std::string error_msg = format("Failed to load corpus tree: The buffer is truncated or corrupted.");
+    throw std::runtime_error(error_msg);
+  }
+
+  symbols = reinterpret_cast<const t9_symbol_id *>(data + header->symbols_offset);
+  probabilities = reinterpret_cast<const float *>(data + header->probabilities_offset);
+  costs = reinterpret_cast<const float *>(data + header->costs_offset);
+  counts = reinterpret_cast<const uint64_t *>(data + header->counts_offset);
+  first_child = reinterpret_cast<const uint32_t *>(data + header->first_child_offset);
+
+  // Children are stored behind their parent in level order, the child ranges have to follow each other and end with the
+  // last node. Otherwise lookups could read outside of the arrays.
+  for (size_t node = 0; node < n_nodes; node++) {
+    if (first_child[node] <= node || first_child[node] > first_child[node + 1]) {
+      std::string error_msg = format("Failed to load corpus tree: The child ranges are corrupted.");
+      throw std::runtime_error(error_msg);
+    }
+  }
+  if (first_child[n_nodes] != n_nodes) {
+    std::string error_msg = format("Failed to load corpus tree: The child ranges are corrupted.");
+    throw std::runtime_error(error_msg);
+  }
+}
+
+uint32_t
+FrozenCorpusTree::find_child(uint32_t node, t9_symbol_id symbol) const {
+  const t9_symbol_id *begin = symbols + first_child[node];
+  const t9_symbol_id *end = symbols + first_child[node + 1];
+
+  auto child = std::lower_bound(begin, end, symbol);
+  if (child != end && *child == symbol) {
+    return static_cast<uint32_t>(child - symbols);
+  }
+
+  return 0;
+}
+
+}  // namespace t9
@@ -10,23 +10,50 @@
 
 namespace t9 {
 NGRAMGenerator::NGRAMGenerator(const Corpus &corpus, size_t ngram_length)
-    : corpus(corpus), ngram_length(ngram_length) {
-  corpus_iterator = corpus.get_train_data().begin();
-  corpus_iterator_end = corpus.get_train_data().end() - ngram_length + 1;
+    : NGRAMGenerator(corpus, ngram_length, 0, count_ngrams(corpus, ngram_length)) {
+}
+
+NGRAMGenerator::NGRAMGenerator(const Corpus &corpus, size_t ngram_length, size_t begin, size_t end)
+    : data(corpus.get_train_data()), ngram_length(ngram_length), position(begin), position_end(end) {
+  if (begin > end || end > count_ngrams(data, ngram_length)) {
+    std::string error_msg = format("Error: The ngram range exceeds the train data.");
+    throw std::runtime_error(error_msg);
+  }
+}
+
+NGRAMGenerator::NGRAMGenerator(t9_symbol_id_view data, size_t ngram_length)
+    : data(data), ngram_length(ngram_length), position(0), position_end(count_ngrams(data, ngram_length)) {
+}
+
+size_t
+NGRAMGenerator::count_ngrams(const Corpus &corpus, size_t ngram_length) {
+  return count_ngrams(corpus.get_train_data(), ngram_length);
+}
+
+size_t
+NGRAMGenerator::count_ngrams(t9_symbol_id_view data, size_t ngram_length) {
+  size_t length = data.size();
+
+  if (ngram_length == 0 || length < ngram_length) {
+    // The data is too short to contain a single ngram.
+    return 0;
+  }
+
+  return length - ngram_length + 1;
 }
 
 bool
 NGRAMGenerator::is_done() const {
-  return (corpus_iterator == corpus_iterator_end);
+  return (position == position_end);
 }
 
-std::string_view
+t9_symbol_id_view
 NGRAMGenerator::generate_ngram() {
-  std::string_view ngram;
+  t9_symbol_id_view ngram;
   if (!is_done()) {
     // Construct a string view for the new ngram.
-    ngram = {corpus_iterator.base(), ngram_length};
-    corpus_iterator++;
+    ngram = {data.data() + position, ngram_length};
+    position++;
   } else {
     std::string error_msg = format(
         "Error: No more ngrams are available. Please check is_done() before requesting an ngram from the generator.");
@@ -0,0 +1,209 @@
+// T9 hashed ngram table -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#include "t9/hashed.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "format.hpp"
+#include "t9/generator.hpp"
+#include "t9/math.hpp"
+
+// Initial number of index bits of the table.
+#define T9_HASHED_INITIAL_INDEX_BITS 10
+
+namespace t9 {
+
+namespace {
+/**
+ * Get the number of symbols packed into a table key.
+ * @param key Non empty table key.
+ * @return Number of symbols.
+ */
+size_t
+key_length(uint64_t key) {
+  return (64 - static_cast<size_t>(__builtin_clzll(key)) + 7) / 8;
+}
+}  // namespace
+
+HashedNGRAMTable::HashedNGRAMTable(const Corpus &corpus, size_t ngram_length)
+    : n_entries(0),
+      index_bits(T9_HASHED_INITIAL_INDEX_BITS),
+      ngram_length(ngram_length),
+      unseen_cost(-t9::ln(0.0f)) {
+  uint64_t n_ngrams = 0;
+
+  if (ngram_length == 0 || ngram_length > T9_HASHED_MAX_NGRAM_LENGTH) {
+    std::string error_msg = format("Failed to build hashed ngram table: The ngram length has to be within [1, %d].",
+                                   T9_HASHED_MAX_NGRAM_LENGTH);
+    throw std::runtime_error(error_msg);
+  }
+
+  slots.assign(size_t(1) << index_bits, Slot{0, 0.0f, 0.0f});
+  counts.assign(slots.size(), 0);
+
+  // Count every prefix of every ngram, just like the corpus tree counts every node along the path of an ngram.
+  corpus.stream_train_data(ngram_length - 1, [this, ngram_length, &n_ngrams](t9_symbol_id_view chunk) {
+    t9::NGRAMGenerator generator(chunk, ngram_length);
+
+    while (!generator.is_done()) {
+      t9_symbol_id_view ngram = generator.generate_ngram();
+      uint64_t key = 0;
+
+      for (size_t order = 0; order < ngram.size(); order++) {
+        key |= static_cast<uint64_t>(ngram[order] + 1u) << (8 * order);
+        increment(key);
+      }
+      n_ngrams++;
+    }
+  });
+
+  // Calculate the conditional probability of each entry given its context (the entry without its last symbol).
+  for (size_t index = 0; index < slots.size(); index++) {
+    Slot &slot = slots[index];
+    if (slot.key == 0) {
+      continue;
+    }
+
+    uint64_t context_count = n_ngrams;
+    size_t length = key_length(slot.key);
+    if (length > 1) {
+      uint64_t context_key = slot.key & ((uint64_t(1) << (8 * (length - 1))) - 1);
+      context_count = counts[find_slot(context_key)];
+    }
+
+    slot.probability = static_cast<float>(counts[index]) / static_cast<float>(context_count);
+    slot.cost = -t9::ln(slot.probability);
+  }
+
+  // The counts are only required to calculate the probabilities.
+  std::vector<uint64_t>().swap(counts);
+}
+
+float
+HashedNGRAMTable::conditional_probability(t9_symbol_id_view sequence) const {
+  uint64_t key = pack(sequence);
+  if (key == 0) {
+    return 0.0f;
+  }
+
+  const Slot &slot = slots[find_slot(key)];
+  return slot.key == key ? slot.probability : 0.0f;
+}
+
+float
+HashedNGRAMTable::conditional_cost(t9_symbol_id_view sequence) const {
+  uint64_t key = pack(sequence);
+  if (key == 0) {
+    return unseen_cost;
+  }
+
+  const Slot &slot = slots[find_slot(key)];
+  return slot.key == key ? slot.cost : unseen_cost;
+}
+
+void
+HashedNGRAMTable::conditional_costs(t9_symbol_id_view context, std::vector<float> &costs) const {
+  uint64_t context_key = pack(context);
+
+  std::fill(costs.begin(), costs.end(), unseen_cost);
+
+  if (context.size() >= ngram_length || (context_key == 0 && !context.empty())) {
+    // No stored key starts with such a context.
+    return;
+  }
+
+  // The context is only packed once, each symbol only adds its own byte.
+  for (size_t symbol = 0; symbol < costs.size(); symbol++) {
+    uint64_t key = context_key | (static_cast<uint64_t>(symbol + 1) << (8 * context.size()));
+    const Slot &slot = slots[find_slot(key)];
+    if (slot.key == key) {
+      costs[symbol] = slot.cost;
+    }
+  }
+}
+
+size_t
+HashedNGRAMTable::memory_usage() const {
+  return slots.size() * sizeof(Slot);
+}
+
+size_t
+HashedNGRAMTable::size() const {
+  return n_entries;
+}
+
+uint64_t
+HashedNGRAMTable::pack(t9_symbol_id_view sequence) {
+  uint64_t key = 0;
+
+  if (sequence.empty() || sequence.size() > T9_HASHED_MAX_NGRAM_LENGTH) {
+    // Such a sequence can never be stored in the table.
+    return 0;
+  }
+
+  // Identifiers are offset by one, so that no stored key is 0.
+  for (size_t order = 0; order < sequence.size(); order++) {
+    key |= static_cast<uint64_t>(sequence[order] + 1u) << (8 * order);
+  }
+
+  return key;
+}
+
+size_t
+HashedNGRAMTable::find_slot(uint64_t key) const {
+  size_t mask = slots.size() - 1;
+
+  // Fibonacci hashing, the upper bits of the product are used as the table index.
+  size_t index = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> (64 - index_bits));
+
+  while (slots[index].key != 0 && slots[index].key != key) {
+    index = (index + 1) & mask;
+  }
+
+  return index;
+}
+
+void
+HashedNGRAMTable::increment(uint64_t key) {
+  // Keep the load factor below 0.5 to keep the probe sequences short.
+  if ((n_entries + 1) * 2 > slots.size()) {
+    grow();
+  }
+
+  size_t index = find_slot(key);
+  if (slots[index].key == 0) {
+    slots[index].key = key;
+    n_entries++;
+  }
+  counts[index]++;
+}
+
+void
+HashedNGRAMTable::grow() {
+  std::vector<Slot> old_slots;
+  std::vector<uint64_t> old_counts;
+
+  old_slots.swap(slots);
+  old_counts.swap(counts);
+
+  index_bits++;
+  slots.assign(size_t(1) << index_bits, Slot{0, 0.0f, 0.0f});
+  counts.assign(slots.size(), 0);
+
+  for (size_t index = 0; index < old_slots.size(); index++) {
+    if (old_slots[index].key != 0) {
+      size_t new_index = find_slot(old_slots[index].key);
+      slots[new_index] = old_slots[index];
+      counts[new_index] = old_counts[index];
+    }
+  }
+}
+
+}  // namespace t9
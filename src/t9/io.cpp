@@ -8,6 +8,10 @@
 
 #include "t9/io.hpp"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 namespace t9::io {
 std::string
 load_text_file(const std::filesystem::path &file_path,
@@ -49,4 +53,115 @@ load_text_file(const std::filesystem::path &file_path,
 
   return data;
 }
+
+TextFileReader::TextFileReader(const std::filesystem::path &file_path, size_t n_chars) {
+  // Check if the file actually exists.
+  if (!std::filesystem::exists(file_path)) {
+    std::string error_msg = format("Failed to find \"%s\": No such file or directory", file_path.c_str());
+    throw std::runtime_error(error_msg);
+  }
+
+  // Request throwing of exceptions in case an error occurs.
+  file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+
+  // Open the file for reading.
+  file.open(file_path, std::ios::in);
+
+  if (file.fail()) {
+    std::string error_msg = format("Failed to open \"%s\"", file_path.c_str());
+    throw std::system_error(errno, std::system_category(), error_msg);
+  }
+
+  // Query the file size in bytes.
+  remaining = std::filesystem::file_size(file_path);
+  if (n_chars > 0) {
+    // If given, read only up to n_chars bytes.
+    remaining = std::min(n_chars, remaining);
+  }
+}
+
+bool
+TextFileReader::is_done() const {
+  return remaining == 0;
+}
+
+void
+TextFileReader::read_chunk(std::string &chunk, size_t chunk_size) {
+  size_t size = std::min(chunk_size, remaining);
+
+  chunk.resize(size);
+  file.read(chunk.data(), static_cast<std::streamsize>(size));
+  remaining -= size;
+}
+
+void
+save_binary_file(const std::filesystem::path &file_path,
+                 const void *data,
+                 size_t size) {
+  std::ofstream file;
+
+  // Request throwing of exceptions in case an error occurs.
+  file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+
+  try {
+    file.open(file_path, std::ios::out | std::ios::binary | std::ios::trunc);
+    file.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+    file.close();
+  } catch (const std::ios_base::failure &) {
+    std::string error_msg = format("Failed to write \"%s\"", file_path.c_str());
+    throw std::system_error(errno, std::system_category(), error_msg);
+  }
+}
+
+MappedFile::MappedFile(const std::filesystem::path &file_path)
+    : address(nullptr), length(0) {
+  int fd;
+
+  // Check if the file actually exists.
+  if (!std::filesystem::exists(file_path)) {
+    std::string error_msg = format("Failed to find \"%s\": No such file or directory", file_path.c_str());
+    throw std::runtime_error(error_msg);
+  }
+
+  fd = open(file_path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::string error_msg = format("Failed to open \"%s\"", file_path.c_str());
+    throw std::system_error(errno, std::system_category(), error_msg);
+  }
+
+  length = std::filesystem::file_size(file_path);
+  if (length == 0) {
+    close(fd);
+    std::string error_msg = format("Failed to map \"%s\": The file is empty", file_path.c_str());
+    throw std::runtime_error(error_msg);
+  }
+
+  address = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+  int error = errno;
+
+  // The mapping stays valid after closing the file descriptor.
+  close(fd);
+
+  if (address == MAP_FAILED) {
+    address = nullptr;
+    std::string error_msg = format("Failed to map \"%s\"", file_path.c_str());
+    throw std::system_error(error, std::system_category(), error_msg);
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (address != nullptr) {
+    munmap(address, length);
+  }
+}
+
+const uint8_t *
+MappedFile::data() const {
+  return static_cast<const uint8_t *>(address);
+}
+
+size_t
+MappedFile::size() const {
+  return length;
+}
 }  // namespace t9::io
@@ -8,31 +8,340 @@
 
 #include "t9/model.hpp"
 
+#include <set>
+#include <stdexcept>
+
 namespace t9 {
 
-Model::Model(const Corpus &corpus, size_t ngram_length, size_t n_paths)
+Model::Model(const Corpus &corpus, size_t ngram_length, size_t n_paths, const ModelOptions &options)
     : corpus(corpus),
       ngram_length(ngram_length),
-      n_paths(n_paths) {
-  search_tree = new SearchTree(ngram_length, n_paths);
-  corpus_tree = new CorpusTree();
+      n_paths(n_paths),
+      options(options) {
+  if (ngram_length < 1) {
+    // The decoders keep the last `ngram_length - 1` symbols of each path as its context.
+    std::string error_msg = format("The ngram length has to be at least 1.");
+    throw std::invalid_argument(error_msg);
+  }
+
+  if (options.paths_per_state > 0 && options.decoder != SearchDecoder::BEAM) {
+    std::string error_msg = format("Hypotheses can only be recombined by the beam decoder.");
+    throw std::runtime_error(error_msg);
+  }
+
+  if (!(options.key_probability >= 0.0f && options.key_probability <= 1.0f)
+      || !(options.neighbour_key_probability >= 0.0f && options.neighbour_key_probability <= 1.0f)) {
+    std::string error_msg = format("The key probabilities have to be within [0, 1].");
+    throw std::invalid_argument(error_msg);
+  }
+
+  // The key, its neighbours and all other keys share the probability of typing a symbol.
+  for (auto const &[key, neighbours] : options.neighbour_keys) {
+    std::set<t9_symbol> distinct_neighbours(neighbours.begin(), neighbours.end());
+    distinct_neighbours.erase(key);
+
+    float neighbours_probability = options.neighbour_key_probability * static_cast<float>(distinct_neighbours.size());
+    if (options.key_probability + neighbours_probability > 1.0f) {
+      std::string error_msg = format("The probabilities of key \"%c\" and its neighbour keys add up to more than 1.",
+                                     key);
+      throw std::invalid_argument(error_msg);
+    }
+  }
+
+  // The key probabilities are fixed, the costs of all pairs of keys and symbols are only calculated once.
+  float match_cost = -t9::ln(options.key_probability);
+  float mismatch_cost = -t9::ln(1.0f - options.key_probability);
+  float neighbour_cost = -t9::ln(options.neighbour_key_probability);
+  size_t n_symbols = corpus.n_symbols();
+
+  emission_costs.assign(corpus.n_keys() * n_symbols, mismatch_cost);
+  for (size_t symbol = 0; symbol < n_symbols; symbol++) {
+    emission_costs[corpus.key_of_symbol(static_cast<t9_symbol_id>(symbol)) * n_symbols + symbol] = match_cost;
+  }
+
+  for (auto const &[key, neighbours] : options.neighbour_keys) {
+    if (!corpus.validate_t9_keys(t9_symbol_sequence(1, key)) || !corpus.validate_t9_keys(neighbours)) {
+      std::string error_msg = format("The neighbour keys of key \"%c\" contain invalid keys.", key);
+      throw std::runtime_error(error_msg);
+    }
+
+    // Symbols of the key can be typed with each of its neighbours.
+    for (auto symbol : corpus.ktoc(key)) {
+      for (auto neighbour : neighbours) {
+        if (neighbour != key) {
+          emission_costs[corpus.key_id(neighbour) * n_symbols + corpus.symbol_id(symbol)] = neighbour_cost;
+        }
+      }
+    }
+  }
+
+  search_tree = nullptr;
+  beam_decoder = nullptr;
+  language_model = nullptr;
+  reset_search_tree();
 }
 
 Model::~Model() {
-  delete corpus_tree;
+  delete language_model;
   delete search_tree;
+  delete beam_decoder;
 }
 
 void
 Model::build_corpus_tree() {
-  corpus_tree->insert_ngrams(corpus, ngram_length);
+  delete language_model;
+  language_model = nullptr;
+
+  ModelBackend backend = options.backend;
+  if (backend == ModelBackend::AUTO) {
+    // Small ngram lengths fit into a dense table, which is the fastest to query. The table can not count the ngrams of
+    // huge train data, which is never fully loaded but may be streamed.
+    size_t dense_bytes = DenseNGRAMTable::required_memory(corpus.n_symbols(), ngram_length);
+    bool is_countable = corpus.train_length() <= T9_DENSE_MAX_NGRAMS;
+    backend = dense_bytes <= options.dense_max_bytes && is_countable ? ModelBackend::DENSE : ModelBackend::TRIE;
+  }
+
+  if (backend == ModelBackend::HASHED) {
+    language_model = new HashedNGRAMTable(corpus, ngram_length);
+    return;
+  }
+
+  if (backend == ModelBackend::DENSE) {
+    language_model = new DenseNGRAMTable(corpus, ngram_length);
+    return;
+  }
+
+  if (backend == ModelBackend::SKETCH) {
+    language_model = new CountMinSketchModel(corpus, ngram_length, options.sketch_max_bytes, options.sketch_depth);
+    return;
+  }
+
+  // The pointer based corpus tree is only required during training.
+  CorpusTree corpus_tree;
+  corpus_tree.insert_ngrams(corpus, ngram_length, options.n_threads);
+  corpus_tree.calculate_probabilities();
+
+  // Freeze the trained tree into a cache friendly representation used for serving.
+  language_model = new FrozenCorpusTree(corpus_tree, corpus.get_alphabet());
+}
+
+void
+Model::build_corpus_tree(const SuffixArray &suffix_array) {
+  if (&suffix_array.get_corpus() != &corpus) {
+    std::string error_msg = format("Failed to build the model: The suffix array was built over a different corpus.");
+    throw std::runtime_error(error_msg);
+  }
+
+  delete language_model;
+  language_model = nullptr;
+
+  CorpusTree corpus_tree;
+  suffix_array.build_corpus_tree(ngram_length, corpus_tree);
+  corpus_tree.calculate_probabilities();
+
+  language_model = new FrozenCorpusTree(corpus_tree, corpus.get_alphabet());
+}
+
+void
+Model::save_corpus_tree(const std::filesystem::path &file_path) const {
+  auto frozen_tree = dynamic_cast<const FrozenCorpusTree *>(language_model);
+
+  if (frozen_tree == nullptr) {
+    std::string error_msg = format("Failed to save the model: No frozen corpus tree was built.");
+    throw std::runtime_error(error_msg);
+  }
+
+  frozen_tree->save(file_path);
+}
+
+void
+Model::load_corpus_tree(const std::filesystem::path &file_path) {
+  auto tree = std::make_unique<FrozenCorpusTree>(file_path);
+
+  // Make sure the model file matches the corpus and the model parameters.
+  if (tree->alphabet() != corpus.get_alphabet()) {
+    std::string error_msg = format("Failed to load \"%s\": The model was trained with different corpus symbols.",
+                                   file_path.c_str());
+    throw std::runtime_error(error_msg);
+  }
+  if (tree->depth() != ngram_length) {
+    std::string error_msg = format("Failed to load \"%s\": The model was trained with a ngram length of %zu.",
+                                   file_path.c_str(), tree->depth());
+    throw std::runtime_error(error_msg);
+  }
+
+  delete language_model;
+  language_model = tree.release();
+}
+
+void
+Model::save_count_snapshot(const std::filesystem::path &file_path) const {
+  CountSnapshot::count(corpus, ngram_length, options.n_threads, file_path);
+}
+
+void
+Model::load_count_snapshot(const std::filesystem::path &file_path) {
+  CountSnapshot snapshot(file_path);
+
+  // Make sure the snapshot matches the corpus and the model parameters.
+  if (snapshot.alphabet() != corpus.get_alphabet()) {
+    std::string error_msg = format("Failed to load \"%s\": The snapshot was counted with different corpus symbols.",
+                                   file_path.c_str());
+    throw std::runtime_error(error_msg);
+  }
+  if (snapshot.ngram_length() != ngram_length) {
+    std::string error_msg = format("Failed to load \"%s\": The snapshot was counted with a ngram length of %zu.",
+                                   file_path.c_str(), snapshot.ngram_length());
+    throw std::runtime_error(error_msg);
+  }
+
+  auto frozen_tree = new FrozenCorpusTree(snapshot);
+  delete language_model;
+  language_model = frozen_tree;
+}
+
+void
+Model::update(const t9_symbol_sequence &text) {
+  auto corpus_tree = dynamic_cast<CorpusTree *>(language_model);
+
+  if (!corpus.validate_corpus_symbols(text)) {
+    std::string error_msg = format("The update text contains invalid symbols.");
+    throw std::runtime_error(error_msg);
+  }
+
+  if (corpus_tree == nullptr) {
+    auto frozen_tree = dynamic_cast<const FrozenCorpusTree *>(language_model);
+
+    if (language_model != nullptr && frozen_tree == nullptr) {
+      std::string error_msg = format("Failed to update the model: Only models using the trie backend can be updated.");
+      throw std::runtime_error(error_msg);
+    }
+
+    // Convert the frozen tree back into a corpus tree that new ngrams can be inserted into.
+    corpus_tree = new CorpusTree();
+    if (frozen_tree != nullptr) {
+      frozen_tree->thaw(*corpus_tree);
+    }
+    delete language_model;
+    language_model = corpus_tree;
+  }
+
+  corpus_tree->insert_sequence(corpus.encode_symbols(text), ngram_length);
+}
+
+void
+Model::freeze_corpus_tree() {
+  auto corpus_tree = dynamic_cast<CorpusTree *>(language_model);
+
+  if (corpus_tree == nullptr) {
+    // The model is not being updated.
+    return;
+  }
+
   corpus_tree->calculate_probabilities();
+  language_model = new FrozenCorpusTree(*corpus_tree, corpus.get_alphabet());
+  delete corpus_tree;
+}
+
+PruneReport
+Model::prune_corpus_tree(const PruneOptions &prune_options) {
+  auto frozen_tree = dynamic_cast<const FrozenCorpusTree *>(language_model);
+  PruneReport report{};
+  size_t max_nodes = prune_options.max_nodes;
+
+  if (frozen_tree == nullptr) {
+    std::string error_msg = format("Failed to prune the model: Only frozen corpus trees can be pruned.");
+    throw std::runtime_error(error_msg);
+  }
+
+  report.n_nodes_before = frozen_tree->size();
+  report.n_bytes_before = frozen_tree->memory_usage();
+
+  if (prune_options.max_bytes > 0) {
+    // Search the largest number of nodes whose frozen tree fits into the memory budget.
+    size_t low = 1;
+    size_t high = report.n_nodes_before;
+    while (low < high) {
+      size_t middle = low + (high - low + 1) / 2;
+      if (FrozenCorpusTree::buffer_size(middle) <= prune_options.max_bytes) {
+        low = middle;
+      } else {
+        high = middle - 1;
+      }
+    }
+    max_nodes = max_nodes == 0 ? low : std::min(max_nodes, low);
+  }
+
+  // Prune a thawed copy of the tree and freeze it again, which renormalizes the probabilities.
+  CorpusTree corpus_tree;
+  frozen_tree->thaw(corpus_tree);
+  corpus_tree.prune(prune_options.criterion, prune_options.min_count, max_nodes);
+  corpus_tree.calculate_probabilities();
+
+  auto pruned_tree = new FrozenCorpusTree(corpus_tree, corpus.get_alphabet());
+  delete language_model;
+  language_model = pruned_tree;
+
+  report.n_nodes_after = pruned_tree->size();
+  report.n_bytes_after = pruned_tree->memory_usage();
+
+  return report;
+}
+
+float
+Model::quantize_corpus_tree(size_t bits) {
+  auto frozen_tree = dynamic_cast<const FrozenCorpusTree *>(language_model);
+
+  if (frozen_tree == nullptr) {
+    std::string error_msg = format("Failed to quantize the model: Only frozen corpus trees can be quantized.");
+    throw std::runtime_error(error_msg);
+  }
+
+  auto quantized_tree = new QuantizedCorpusTree(*frozen_tree, bits);
+  delete language_model;
+  language_model = quantized_tree;
+
+  return quantized_tree->max_error();
+}
+
+const BloomFilteredModel *
+Model::filter_unseen_sequences(float false_positive_rate) {
+  auto frozen_tree = dynamic_cast<const FrozenCorpusTree *>(language_model);
+
+  if (frozen_tree == nullptr) {
+    std::string error_msg = format("Failed to filter the model: Only frozen corpus trees can be filtered.");
+    throw std::runtime_error(error_msg);
+  }
+
+  // The filtered model takes over the frozen tree.
+  auto filtered_model = new BloomFilteredModel(frozen_tree, false_positive_rate);
+  language_model = filtered_model;
+
+  return filtered_model;
 }
 
 void
 Model::reset_search_tree() {
+  // Reuse the memory of the decoder in use.
+  if (options.decoder == SearchDecoder::TREE && search_tree != nullptr) {
+    search_tree->reset();
+    return;
+  }
+  if (options.decoder == SearchDecoder::BEAM && beam_decoder != nullptr) {
+    beam_decoder->reset();
+    return;
+  }
+
   delete search_tree;
-  search_tree = new SearchTree(ngram_length, n_paths);
+  delete beam_decoder;
+  search_tree = nullptr;
+  beam_decoder = nullptr;
+
+  if (options.decoder == SearchDecoder::TREE) {
+    search_tree = new SearchTree(ngram_length, n_paths);
+  } else {
+    beam_decoder = new BeamDecoder(ngram_length, n_paths, options.paths_per_state);
+  }
 }
 
 std::vector<std::pair<t9_symbol_sequence, float>>
@@ -42,13 +351,25 @@ Model::autocomplete(const t9_symbol_sequence &input) {
 
   // Validate that the sequence to be inserted only contains valid lexicon symbols.
   if (corpus.validate_t9_keys(input)) {
+    if (beam_decoder != nullptr) {
+      std::vector<std::pair<t9_symbol_id_sequence, float>> paths;
+
+      beam_decoder->type(corpus.encode_keys(input), this);
+      beam_decoder->best_paths(paths);
+
+      for (const auto &[sequence, score] : paths) {
+        suggestions.emplace_back(corpus.decode_symbols(sequence), score);
+      }
+      return suggestions;
+    }
+
     // Autocomplete a given input sequence based onm the model.
-    search_tree->type(input, this);
+    search_tree->type(corpus.encode_keys(input), this);
 
     // Create a collection containing the suggested completions and their scores.
     for (const auto &path : search_tree->best_paths) {
       suggestion = {
-          path.to_string(),
+          corpus.decode_symbols(path.to_sequence()),
           path.get_probability()
       };
       suggestions.push_back(suggestion);
@@ -61,6 +382,16 @@ Model::autocomplete(const t9_symbol_sequence &input) {
 
 }
 
+size_t
+Model::get_n_paths() const {
+  return n_paths;
+}
+
+const ModelOptions &
+Model::get_options() const {
+  return options;
+}
+
 float
 Model::evaluate() {
   float error;
@@ -98,21 +429,8 @@ Model::evaluate() {
 }
 
 float
-Model::probability_key_when_symbol(t9_symbol key, t9_symbol symbol) const {
-  float prob;
-  const t9_symbol_sequence &corpus_symbols(corpus.ktoc(key));
-
-  prob = PROBABILITY_BUTTON;
-
-  t9_symbol_sequence::size_type location = corpus_symbols.find(symbol);
-
-  if (location != t9_symbol_sequence::npos) {
-    // Symbol is assigned to the button.
-    return prob;
-  }
-
-  // Letter is not assigned to the button.
-  return 1.0f - prob;
+Model::probability_key_when_symbol(t9_symbol_id key, t9_symbol_id symbol) const {
+  return std::exp(-cost_key_when_symbol(key, symbol));
 }
 
 }  // namespace t9
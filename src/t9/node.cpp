@@ -8,17 +8,26 @@
 
 #include "t9/node.hpp"
 
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "t9/model.hpp"
 
 namespace t9 {
 
-Node::Node(t9_symbol symbol, float probability) :
+Node::Node(t9_symbol_id symbol, float probability) :
     symbol(symbol), probability(probability) {
 
 }
 
-CorpusNode::CorpusNode(t9_symbol symbol) :
-    Node(symbol, 0.0f), count(0), parent(nullptr) {
+CorpusNode::CorpusNode(t9_symbol_id symbol) :
+    Node(symbol, 0.0f), count(0), children_count(0), parent(nullptr) {
+  std::memset(child_symbols, T9_INVALID_SYMBOL_ID, sizeof(child_symbols));
 }
 
 CorpusNode::~CorpusNode() {
@@ -28,127 +37,303 @@ CorpusNode::~CorpusNode() {
 }
 
 CorpusNode *
-CorpusNode::get_child_safe(t9_symbol symbol) {
-  // Search for an existing child with the desired symbol.
-  for (const auto child : children) {
-    if (child->symbol == symbol) {
-      // A child with the symbol already exists.
-      return child;
+CorpusNode::get_child(t9_symbol_id symbol) const {
+  if (child_index) {
+    // Large node, look the position of the child up directly.
+    uint8_t position = child_index[symbol];
+    return position == T9_INVALID_SYMBOL_ID ? nullptr : children[position];
+  }
+
+  // Small node, compare the symbols of all children at once.
+#ifdef __SSE2__
+  __m128i symbols = _mm_load_si128(reinterpret_cast<const __m128i *>(child_symbols));
+  __m128i matches = _mm_cmpeq_epi8(symbols, _mm_set1_epi8(static_cast<char>(symbol)));
+  unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(matches)) & ((1u << children.size()) - 1u);
+
+  return mask == 0 ? nullptr : children[__builtin_ctz(mask)];
+#else
+  for (size_t position = 0; position < children.size(); position++) {
+    if (child_symbols[position] == symbol) {
+      return children[position];
     }
   }
 
+  return nullptr;
+#endif
+}
+
+CorpusNode *
+CorpusNode::get_child_safe(t9_symbol_id symbol) {
+  // Search for an existing child with the desired symbol.
+  CorpusNode *existing = get_child(symbol);
+  if (existing != nullptr) {
+    // A child with the symbol already exists.
+    return existing;
+  }
+
   // There is no child containing with that symbol, create and insert a new one.
   auto child = new CorpusNode(symbol);
-  child->parent = make_observer(this);
-  children.push_back(child);
+  link_child(child);
 
   return child;
 }
 
 void
-CorpusNode::insert_ngram(std::string_view ngram) {
+CorpusNode::remove_child(CorpusNode *child) {
+  auto child_iter = std::find(children.begin(), children.end(), child);
+  if (child_iter != children.end()) {
+    children_count -= child->count;
+    children.erase(child_iter);
+    delete child;
+    rebuild_child_index();
+  }
+}
+
+CorpusNode *
+CorpusNode::get_parent() const {
+  return parent.get();
+}
+
+void
+CorpusNode::insert_ngram(t9_symbol_id_view ngram) {
   CorpusNode *child = get_child_safe(ngram.front());
   child->count++;
+  children_count++;
 
   if (ngram.length() > 1) {
     auto begin = &ngram.at(1);
     auto len = ngram.length() - 1;
-    std::string_view child_ngram(begin, len);
+    t9_symbol_id_view child_ngram(begin, len);
     child->insert_ngram(child_ngram);
   }
 }
 
+void
+CorpusNode::merge(CorpusNode *other) {
+  count += other->count;
+  children_count += other->children_count;
+
+  for (auto other_child : other->children) {
+    CorpusNode *child = get_child(other_child->symbol);
+
+    if (child == nullptr) {
+      // There is no matching child, take over the whole subtree.
+      link_child(other_child);
+    } else {
+      // Both nodes contain the child, merge it recursively.
+      child->merge(other_child);
+      delete other_child;
+    }
+  }
+
+  other->children.clear();
+  other->rebuild_child_index();
+}
+
 void
 CorpusNode::calculate_probabilities() {
   for (auto child : children) {
-    child->probability = static_cast<float>(child->count) / static_cast<float>(this->count);
+    child->probability = static_cast<float>(child->count) / static_cast<float>(children_count);
     child->calculate_probabilities();
   }
 }
 
 float
-CorpusNode::conditional_probability(std::string_view sequence) const {
-  for (auto child : children) {
-    // Check if there is a child with a symbol corresponding to the first symbol of the sequence.
-    if (child->symbol == sequence.front()) {
-      // Matching child was found.
-      if (sequence.length() == 1) {
-        // End of sequence reached, return probability.
-        return child->probability;
-      } else {
-        // Find child for the next character of the sequence.
-        std::string_view next_sequence(sequence);
-        next_sequence.remove_prefix(1);
-        return child->conditional_probability(next_sequence);
-      }
+CorpusNode::conditional_probability(t9_symbol_id_view sequence) const {
+  const CorpusNode *node = this;
+
+  if (sequence.empty()) {
+    return 0.0;
+  }
+
+  // Descend the tree to the parent of the last symbol of the sequence.
+  for (size_t position = 0; position + 1 < sequence.length(); position++) {
+    node = node->get_child(sequence[position]);
+    if (node == nullptr) {
+      // Sequence is not in tree.
+      return 0.0;
     }
   }
 
-  // Sequence is not in tree.
-  return 0.0;
-}
+  const CorpusNode *child = node->get_child(sequence.back());
+  if (child == nullptr) {
+    // Sequence is not in tree.
+    return 0.0;
+  }
 
-SearchNode::SearchNode(t9_symbol symbol, float probability) :
-    Node(symbol, probability), parent(nullptr) {
+  // End of sequence reached, derive the probability from the counts.
+  return static_cast<float>(child->count) / static_cast<float>(node->children_count);
 }
 
-SearchNode::~SearchNode() {
+size_t
+CorpusNode::memory_usage() const {
+  size_t size = sizeof(CorpusNode) + children.capacity() * sizeof(CorpusNode *);
+
+  if (child_index) {
+    size += 256 * sizeof(uint8_t);
+  }
+
   for (auto child : children) {
-    delete child;
+    size += child->memory_usage();
   }
+
+  return size;
 }
 
 void
-SearchNode::insert(t9_symbol symbol, t9_symbol_sequence &sequence, Model *model) {
-  t9_symbol_sequence buffer;
-  float prob_t_b;
-  float prob_b_bb;
-  float prob;
+CorpusNode::link_child(CorpusNode *child) {
+  size_t position = children.size();
 
-  if (is_leaf()) {
-    // Append a child for each corpus symbols to the leaf node.
-    const auto &corpus_symbols = model->corpus.corpus_set;
+  child->parent = make_observer(this);
+  children.push_back(child);
 
-    for (auto corpus_symbol : corpus_symbols) {
-      size_t sequence_length = sequence.length();
+  if (position < T9_CORPUS_NODE_SMALL_SIZE) {
+    child_symbols[position] = child->symbol;
+  } else if (position == T9_CORPUS_NODE_SMALL_SIZE) {
+    // The node outgrew the small representation.
+    rebuild_child_index();
+  } else {
+    child_index[child->symbol] = static_cast<uint8_t>(position);
+  }
+}
 
-      buffer = sequence;
-      if (sequence_length >= model->ngram_length) {
-        buffer.erase(0, sequence_length - (model->ngram_length - 1));
-      }
-      buffer.push_back(corpus_symbol);
+void
+CorpusNode::rebuild_child_index() {
+  std::memset(child_symbols, T9_INVALID_SYMBOL_ID, sizeof(child_symbols));
 
-      // Calculate child probability.
-      prob_t_b = -t9::ln(model->probability_key_when_symbol(symbol, corpus_symbol));
-      prob_b_bb = -t9::ln(model->corpus_tree->conditional_probability(buffer));
-      prob = prob_t_b + prob_b_bb + this->probability;
+  if (children.size() <= T9_CORPUS_NODE_SMALL_SIZE) {
+    child_index.reset();
+    for (size_t position = 0; position < children.size(); position++) {
+      child_symbols[position] = children[position]->symbol;
+    }
+    return;
+  }
 
-      auto child = new SearchNode(corpus_symbol, prob);
-      child->parent = make_observer(this);
+  if (!child_index) {
+    child_index = std::make_unique<uint8_t[]>(256);
+  }
+  std::memset(child_index.get(), T9_INVALID_SYMBOL_ID, 256);
+  for (size_t position = 0; position < children.size(); position++) {
+    child_index[children[position]->symbol] = static_cast<uint8_t>(position);
+  }
+}
+
+SearchNode::SearchNode(t9_symbol_id symbol, float probability) :
+    Node(symbol, probability),
+    parent(nullptr),
+    first_child(nullptr),
+    last_child(nullptr),
+    previous_sibling(nullptr),
+    next_sibling(nullptr) {
+}
 
-      // Add child to parent.
-      children.push_back(child);
+void
+SearchNode::insert(t9_symbol_id symbol,
+                   t9_symbol_id_sequence &sequence,
+                   std::vector<float> &costs,
+                   SearchNodePool &pool,
+                   Model *model) {
+  if (is_leaf()) {
+    // Only the last (ngram_length - 1) symbols of the sequence form the context of the new symbol.
+    t9_symbol_id_view context(sequence);
+    if (context.length() >= model->ngram_length) {
+      context.remove_prefix(context.length() - (model->ngram_length - 1));
     }
+
+    expand(symbol, context, costs, pool, model);
   } else {
     // Descend the tree until a leaf node.
-    for (auto child : children) {
-      buffer = sequence;
-      buffer.push_back(child->symbol);
+    for (SearchNode *child = first_child; child != nullptr; child = child->next_sibling) {
+      sequence.push_back(child->symbol);
+      child->insert(symbol, sequence, costs, pool, model);
+      sequence.pop_back();
+    }
+  }
+}
+
+template<size_t ngram_length>
+void
+SearchNode::insert_fixed(t9_symbol_id symbol,
+                         const std::array<t9_symbol_id, ngram_length - 1> &context,
+                         size_t context_length,
+                         std::vector<float> &costs,
+                         SearchNodePool &pool,
+                         Model *model) {
+  constexpr size_t context_size = ngram_length - 1;
+
+  if (is_leaf()) {
+    expand(symbol, t9_symbol_id_view(context.data() + context_size - context_length, context_length), costs, pool,
+           model);
+    return;
+  }
+
+  // Descend the tree until a leaf node.
+  std::array<t9_symbol_id, context_size> child_context;
+  size_t child_context_length = std::min(context_length + 1, context_size);
+
+  for (size_t position = 0; position + 1 < context_size; position++) {
+    child_context[position] = context[position + 1];
+  }
+
+  for (SearchNode *child = first_child; child != nullptr; child = child->next_sibling) {
+    // The symbol of the child is shifted into the context, the oldest symbol drops out.
+    child_context[context_size - 1] = child->symbol;
+    child->insert_fixed<ngram_length>(symbol, child_context, child_context_length, costs, pool, model);
+  }
+}
+
+template void SearchNode::insert_fixed<2>(t9_symbol_id, const std::array<t9_symbol_id, 1> &, size_t,
+                                          std::vector<float> &, SearchNodePool &, Model *);
+template void SearchNode::insert_fixed<3>(t9_symbol_id, const std::array<t9_symbol_id, 2> &, size_t,
+                                          std::vector<float> &, SearchNodePool &, Model *);
+template void SearchNode::insert_fixed<4>(t9_symbol_id, const std::array<t9_symbol_id, 3> &, size_t,
+                                          std::vector<float> &, SearchNodePool &, Model *);
+template void SearchNode::insert_fixed<5>(t9_symbol_id, const std::array<t9_symbol_id, 4> &, size_t,
+                                          std::vector<float> &, SearchNodePool &, Model *);
+template void SearchNode::insert_fixed<6>(t9_symbol_id, const std::array<t9_symbol_id, 5> &, size_t,
+                                          std::vector<float> &, SearchNodePool &, Model *);
 
-      child->insert(symbol, buffer, model);
+void
+SearchNode::expand(t9_symbol_id symbol, t9_symbol_id_view context, std::vector<float> &costs, SearchNodePool &pool,
+                   Model *model) {
+  float prob_t_b;
+  float prob_b_bb;
+  float prob;
+  const auto n_symbols = static_cast<t9_symbol_id>(costs.size());
+
+  const float *key_costs = model->costs_of_key(symbol);
+
+  // Look up the costs of all symbols following the context at once.
+  model->language_model->conditional_costs(context, costs);
+
+  for (t9_symbol_id corpus_symbol = 0; corpus_symbol < n_symbols; corpus_symbol++) {
+    // Calculate child probability from the precomputed costs.
+    prob_t_b = key_costs[corpus_symbol];
+    prob_b_bb = costs[corpus_symbol];
+    prob = prob_t_b + prob_b_bb + this->probability;
+
+    auto child = pool.create(corpus_symbol, prob);
+    child->parent = make_observer(this);
+
+    // Add child to parent.
+    child->previous_sibling = last_child;
+    if (last_child != nullptr) {
+      last_child->next_sibling = child;
+    } else {
+      first_child = child;
     }
+    last_child = child;
   }
 }
 
 bool
 SearchNode::is_leaf() const {
-  return children.empty();
+  return first_child == nullptr;
 }
 
 void
-SearchNode::prune(SearchPath &path, std::vector<SearchPath> &best_paths) {
+SearchNode::prune(SearchPath &path, std::vector<SearchPath> &best_paths, SearchNodePool &pool) {
   bool found;
-  std::string path_string;
 
   if (is_leaf()) {
     // End of tree was reached.
@@ -164,7 +349,6 @@ SearchNode::prune(SearchPath &path, std::vector<SearchPath> &best_paths) {
     if (!found) {
       // Path is not known to be one of the best paths.
       // Prune this path.
-      path_string = path.to_string();
 
       // Prune all nodes contained in the path, starting at the end of the path.
       auto path_iter = path.crbegin();
@@ -176,13 +360,9 @@ SearchNode::prune(SearchPath &path, std::vector<SearchPath> &best_paths) {
         if (node->is_leaf()) {
           // Prune the node.
 
-          // Find and delete the node in the collection of the parents children.
-          auto &parent_children = node->parent->children;
-          auto child_iter = std::find(parent_children.begin(), parent_children.end(), node);
-          if (child_iter != parent_children.end()) {
-            parent_children.erase(child_iter);
-            delete node;
-          }
+          // Remove the node from the children of its parent and return it to the pool.
+          node->parent->unlink_child(node);
+          pool.release(node);
         } else {
           // There are still children, stop therefore we can not delete the current note or its parent nodes.
           break;
@@ -192,50 +372,117 @@ SearchNode::prune(SearchPath &path, std::vector<SearchPath> &best_paths) {
       }
     }
   } else {
-    // Iterate all over a copy of all children of the node as we might delete some in between.
-    auto children_copy(children);
-    for (auto child : children_copy) {
+    // Remember the next child before descending, as the child might be removed in between. Siblings of the child are
+    // never removed while descending into it.
+    SearchNode *next;
+    for (SearchNode *child = first_child; child != nullptr; child = next) {
+      next = child->next_sibling;
+
       // Descend down a path for each child.
       path.push_back(child);
-      child->prune(path, best_paths);
+      child->prune(path, best_paths, pool);
       path.pop_back();
     }
   }
 }
 
 void
-SearchNode::search_paths(SearchPath &current_path, std::vector<SearchPath> &best_paths, size_t max_paths) {
-  if (best_paths.size() >= max_paths) {
-    // Maximal number of paths to search was reached.
-    if (probability >= best_paths.back().get_probability()) {
-      // Current path is not better than the worst path in the list of known best paths.
-      // Skip this path.
-      return;
-    }
+SearchNode::search_paths(SearchPathHeap &heap) {
+  if (heap.is_rejected(probability)) {
+    // Maximal number of paths to search was reached and the current path is not better than the worst path in the
+    // heap. Skip this path.
+    return;
   }
 
   if (is_leaf()) {
     // Leaf node was hit, the taken path therefore spans the whole tree depth.
+    heap.offer(this);
+  } else {
+    // Descend tree until a leaf node is hit.
+    for (SearchNode *child = first_child; child != nullptr; child = child->next_sibling) {
+      // Test the child before descending, to not descend into subtrees that are skipped anyway.
+      if (!heap.is_rejected(child->probability)) {
+        child->search_paths(heap);
+      }
+    }
+  }
+}
 
-    // Append a copy of the path to the list of best paths.
-    best_paths.push_back(current_path);
+void
+SearchNode::unlink_child(SearchNode *child) {
+  if (child->previous_sibling != nullptr) {
+    child->previous_sibling->next_sibling = child->next_sibling;
+  } else {
+    first_child = child->next_sibling;
+  }
 
-    // Sort list of best paths.
-    std::sort(best_paths.begin(), best_paths.end());
+  if (child->next_sibling != nullptr) {
+    child->next_sibling->previous_sibling = child->previous_sibling;
+  } else {
+    last_child = child->previous_sibling;
+  }
 
-    // In case there are now more best paths than requested by the model delete the worst path.
-    if (best_paths.size() > max_paths) {
-      best_paths.pop_back();
-    }
+  child->previous_sibling = nullptr;
+  child->next_sibling = nullptr;
+}
+
+SearchNodePool::SearchNodePool()
+    : slab(0), position(0), free_list(nullptr), n_nodes(0) {
+  static_assert(std::is_trivially_destructible<SearchNode>::value, "Search nodes are released without destruction.");
+}
+
+SearchNodePool::~SearchNodePool() {
+  for (auto nodes : slabs) {
+    ::operator delete(nodes);
+  }
+}
+
+SearchNode *
+SearchNodePool::create(t9_symbol_id symbol, float probability) {
+  void *memory;
+
+  if (free_list != nullptr) {
+    // Reuse a released node.
+    memory = free_list;
+    free_list = free_list->next_sibling;
   } else {
-    // Descend tree until a leaf node is hit.
-    for (auto child : children) {
-      // Descend down separate a path for each child.
-      current_path.push_back(child);
-      child->search_paths(current_path, best_paths, max_paths);
-      current_path.pop_back();
+    if (position == T9_SEARCH_NODE_SLAB_SIZE) {
+      slab++;
+      position = 0;
     }
+    if (slab == slabs.size()) {
+      slabs.push_back(static_cast<SearchNode *>(::operator new(T9_SEARCH_NODE_SLAB_SIZE * sizeof(SearchNode))));
+    }
+    memory = slabs[slab] + position++;
   }
+
+  n_nodes++;
+  return new(memory) SearchNode(symbol, probability);
+}
+
+void
+SearchNodePool::release(SearchNode *node) {
+  node->next_sibling = free_list;
+  free_list = node;
+  n_nodes--;
+}
+
+void
+SearchNodePool::reset() {
+  slab = 0;
+  position = 0;
+  free_list = nullptr;
+  n_nodes = 0;
+}
+
+size_t
+SearchNodePool::size() const {
+  return n_nodes;
+}
+
+size_t
+SearchNodePool::memory_usage() const {
+  return slabs.size() * T9_SEARCH_NODE_SLAB_SIZE * sizeof(SearchNode);
 }
 
 }  // namesapce t9
@@ -8,6 +8,8 @@
 
 #include "t9/path.hpp"
 
+#include <algorithm>
+
 #include "t9/tree.hpp"
 
 namespace t9 {
@@ -59,16 +61,16 @@ SearchPath::size() const {
   return nodes.size();
 }
 
-t9_symbol_sequence
-SearchPath::to_string() const {
-  std::string str;
-  str.reserve(size());
+t9_symbol_id_sequence
+SearchPath::to_sequence() const {
+  t9_symbol_id_sequence sequence;
+  sequence.reserve(size());
 
   for (const SearchNode *node : nodes) {
-    str.push_back(node->symbol);
+    sequence.push_back(node->symbol);
   }
 
-  return str;
+  return sequence;
 }
 
 float
@@ -105,4 +107,49 @@ SearchPath::operator!=(const SearchPath &other) const {
   return !(other == *this);
 }
 
+SearchPathHeap::SearchPathHeap(size_t max_paths)
+    : max_paths(max_paths), n_offered(0) {
+  entries.reserve(max_paths + 1);
+}
+
+void
+SearchPathHeap::offer(SearchNode *leaf) {
+  entries.push_back({leaf->probability, n_offered++, leaf});
+  std::push_heap(entries.begin(), entries.end());
+
+  if (entries.size() > max_paths) {
+    // Drop the worst leaf.
+    std::pop_heap(entries.begin(), entries.end());
+    entries.pop_back();
+  }
+}
+
+void
+SearchPathHeap::clear() {
+  entries.clear();
+  n_offered = 0;
+}
+
+void
+SearchPathHeap::extract(std::vector<SearchPath> &best_paths) {
+  std::sort_heap(entries.begin(), entries.end());
+
+  best_paths.clear();
+  for (const Entry &entry : entries) {
+    // Collect the nodes from the leaf up to, but excluding, the root.
+    nodes.clear();
+    for (SearchNode *node = entry.leaf; node->parent; node = node->parent.get()) {
+      nodes.push_back(node);
+    }
+
+    best_paths.emplace_back();
+    SearchPath &path = best_paths.back();
+    for (auto node_iter = nodes.crbegin(); node_iter != nodes.crend(); node_iter++) {
+      path.push_back(*node_iter);
+    }
+  }
+
+  entries.clear();
+}
+
 }  // namespace t9
\ No newline at end of file
@@ -0,0 +1,159 @@
+// T9 quantized corpus tree -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#include "t9/quantized.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "format.hpp"
+
+namespace t9 {
+
+QuantizedCorpusTree::QuantizedCorpusTree(const FrozenCorpusTree &tree, size_t bits)
+    : bits(bits), unseen_cost(tree.unseen_cost()), error(0.0f) {
+  std::vector<float> costs;
+  std::vector<float> bin_upper;
+  size_t n_nodes = tree.n_nodes;
+  size_t n_codes;
+
+  if (bits != 8 && bits != 16) {
+    std::string error_msg = format("Failed to quantize corpus tree: Only 8 and 16 bit codes are supported.");
+    throw std::runtime_error(error_msg);
+  }
+  n_codes = size_t(1) << bits;
+
+  // Copy the tree structure.
+  symbols.assign(tree.symbols, tree.symbols + n_nodes);
+  first_child.assign(tree.first_child, tree.first_child + n_nodes + 1);
+
+  // Sort the costs of all nodes except the root, which is never the result of a lookup.
+  costs.assign(tree.costs + 1, tree.costs + n_nodes);
+  std::sort(costs.begin(), costs.end());
+
+  std::vector<float> distinct(costs);
+  distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+
+  if (distinct.size() <= n_codes) {
+    // Each distinct cost gets its own code, the quantization is lossless.
+    codebook = distinct;
+    bin_upper = distinct;
+  } else {
+    // Split the sorted costs into equally populated bins, each bin decodes to its mean cost.
+    for (size_t bin = 0; bin < n_codes; bin++) {
+      size_t begin = costs.size() * bin / n_codes;
+      size_t end = costs.size() * (bin + 1) / n_codes;
+      double sum = 0.0;
+
+      for (size_t index = begin; index < end; index++) {
+        sum += costs[index];
+      }
+      codebook.push_back(static_cast<float>(sum / static_cast<double>(end - begin)));
+      bin_upper.push_back(costs[end - 1]);
+    }
+  }
+
+  // Assign each node the code of the closest codebook entry among the bin it falls into and the previous one.
+  auto encode = [&](float cost) -> size_t {
+    size_t code = std::lower_bound(bin_upper.begin(), bin_upper.end(), cost) - bin_upper.begin();
+    code = std::min(code, codebook.size() - 1);
+    if (code > 0 && std::fabs(codebook[code - 1] - cost) < std::fabs(codebook[code] - cost)) {
+      code--;
+    }
+    error = std::max(error, std::fabs(codebook[code] - cost));
+    return code;
+  };
+
+  if (bits == 8) {
+    codes_8.resize(n_nodes, 0);
+    for (size_t node = 1; node < n_nodes; node++) {
+      codes_8[node] = static_cast<uint8_t>(encode(tree.costs[node]));
+    }
+  } else {
+    codes_16.resize(n_nodes, 0);
+    for (size_t node = 1; node < n_nodes; node++) {
+      codes_16[node] = static_cast<uint16_t>(encode(tree.costs[node]));
+    }
+  }
+}
+
+float
+QuantizedCorpusTree::conditional_probability(t9_symbol_id_view sequence) const {
+  if (find_node(sequence) == 0) {
+    // Sequence is not in tree.
+    return 0.0f;
+  }
+
+  return std::exp(-conditional_cost(sequence));
+}
+
+float
+QuantizedCorpusTree::conditional_cost(t9_symbol_id_view sequence) const {
+  uint32_t node = find_node(sequence);
+
+  if (node == 0) {
+    // Sequence is not in tree.
+    return unseen_cost;
+  }
+
+  return bits == 8 ? codebook[codes_8[node]] : codebook[codes_16[node]];
+}
+
+void
+QuantizedCorpusTree::conditional_costs(t9_symbol_id_view context, std::vector<float> &costs) const {
+  uint32_t node = find_node(context);
+
+  std::fill(costs.begin(), costs.end(), unseen_cost);
+
+  if (node == 0 && !context.empty()) {
+    // Context is not in tree.
+    return;
+  }
+
+  for (uint32_t child = first_child[node]; child < first_child[node + 1]; child++) {
+    if (symbols[child] < costs.size()) {
+      costs[symbols[child]] = bits == 8 ? codebook[codes_8[child]] : codebook[codes_16[child]];
+    }
+  }
+}
+
+size_t
+QuantizedCorpusTree::memory_usage() const {
+  return codebook.size() * sizeof(float)
+      + symbols.size() * sizeof(t9_symbol_id)
+      + first_child.size() * sizeof(uint32_t)
+      + codes_8.size() * sizeof(uint8_t)
+      + codes_16.size() * sizeof(uint16_t);
+}
+
+float
+QuantizedCorpusTree::max_error() const {
+  return error;
+}
+
+uint32_t
+QuantizedCorpusTree::find_node(t9_symbol_id_view sequence) const {
+  uint32_t node = 0;
+
+  // Descend the tree one symbol at a time.
+  for (auto symbol : sequence) {
+    auto begin = symbols.begin() + first_child[node];
+    auto end = symbols.begin() + first_child[node + 1];
+
+    auto child = std::lower_bound(begin, end, symbol);
+    if (child == end || *child != symbol) {
+      return 0;
+    }
+    node = static_cast<uint32_t>(child - symbols.begin());
+  }
+
+  return node;
+}
+
+}  // namespace t9
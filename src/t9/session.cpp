@@ -0,0 +1,109 @@
+// T9 typing session -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#include "t9/session.hpp"
+
+#include <stdexcept>
+#include <string>
+
+#include "format.hpp"
+
+namespace t9 {
+
+TypingSession::TypingSession(Model &model, size_t max_checkpoints)
+    : model(model),
+      decoder(model.ngram_length, model.get_n_paths(), model.get_options().paths_per_state, max_checkpoints),
+      latency(0.0) {
+}
+
+const std::vector<std::pair<t9_symbol_sequence, float>> &
+TypingSession::type(t9_symbol key) {
+  t9_symbol_id key_id = model.corpus.key_id(key);
+  if (key_id == T9_INVALID_SYMBOL_ID) {
+    std::string error_msg = format("Failed to type \"%c\": The key is not a valid T9 key.", key);
+    throw std::runtime_error(error_msg);
+  }
+
+  key_timer.restart();
+  decoder.insert(key_id, &model);
+  update_suggestions();
+  key_timer.stop();
+
+  input.push_back(key);
+  latency = key_timer.duration_ms();
+  latencies.push_back(latency);
+
+  return current_suggestions;
+}
+
+const std::vector<std::pair<t9_symbol_sequence, float>> &
+TypingSession::backspace() {
+  if (input.empty()) {
+    latency = 0.0;
+    return current_suggestions;
+  }
+
+  key_timer.restart();
+  input.pop_back();
+  latencies.pop_back();
+
+  if (!decoder.erase()) {
+    // The checkpoint of the key was dropped, type the remaining keys again.
+    decoder.reset();
+    for (auto key : input) {
+      decoder.insert(model.corpus.key_id(key), &model);
+    }
+  }
+  update_suggestions();
+  key_timer.stop();
+
+  latency = key_timer.duration_ms();
+
+  return current_suggestions;
+}
+
+void
+TypingSession::clear() {
+  decoder.reset();
+  input.clear();
+  latencies.clear();
+  current_suggestions.clear();
+  latency = 0.0;
+}
+
+const std::vector<std::pair<t9_symbol_sequence, float>> &
+TypingSession::suggestions() const {
+  return current_suggestions;
+}
+
+const t9_symbol_sequence &
+TypingSession::keys() const {
+  return input;
+}
+
+const std::vector<double> &
+TypingSession::latencies_ms() const {
+  return latencies;
+}
+
+double
+TypingSession::last_latency_ms() const {
+  return latency;
+}
+
+void
+TypingSession::update_suggestions() {
+  decoder.best_paths(paths);
+
+  current_suggestions.clear();
+  for (const auto &[sequence, score] : paths) {
+    current_suggestions.emplace_back(model.corpus.decode_symbols(sequence), score);
+  }
+}
+
+}  // namespace t9
@@ -0,0 +1,181 @@
+// T9 count-min sketch -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#include "t9/sketch.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "format.hpp"
+#include "t9/generator.hpp"
+#include "t9/math.hpp"
+
+namespace t9 {
+
+namespace {
+/**
+ * Hash a symbol sequence.
+ * @param sequence Corpus symbol sequence.
+ * @return 64 bit hash of the sequence.
+ */
+uint64_t
+hash_sequence(t9_symbol_id_view sequence) {
+  // FNV-1a over the symbols, followed by a finalizer mixing all bits.
+  uint64_t value = 0xCBF29CE484222325ull;
+  for (auto symbol : sequence) {
+    value = (value ^ symbol) * 0x100000001B3ull;
+  }
+
+  value ^= value >> 33;
+  value *= 0xFF51AFD7ED558CCDull;
+  value ^= value >> 33;
+  value *= 0xC4CEB9FE1A85EC53ull;
+  value ^= value >> 33;
+
+  return value;
+}
+}  // namespace
+
+CountMinSketchModel::CountMinSketchModel(const Corpus &corpus, size_t ngram_length, size_t max_bytes, size_t depth)
+    : depth(depth),
+      width(0),
+      ngram_length(ngram_length),
+      n_ngrams(0),
+      unseen_cost(-t9::ln(0.0f)) {
+  std::vector<size_t> cells(depth);
+
+  if (ngram_length == 0 || depth == 0) {
+    std::string error_msg = format("Failed to build count-min sketch: The ngram length and the depth have to be > 0.");
+    throw std::runtime_error(error_msg);
+  }
+
+  width = std::max<size_t>(1, max_bytes / (depth * sizeof(uint32_t)));
+  counters.assign(depth * width, 0);
+
+  // Count every prefix of every ngram, just like the corpus tree counts every node along the path of an ngram.
+  corpus.stream_train_data(ngram_length - 1, [this, ngram_length, &cells](t9_symbol_id_view chunk) {
+    t9::NGRAMGenerator generator(chunk, ngram_length);
+
+    while (!generator.is_done()) {
+      t9_symbol_id_view ngram = generator.generate_ngram();
+
+      for (size_t length = 1; length <= ngram.size(); length++) {
+        increment(ngram.substr(0, length), cells);
+      }
+      n_ngrams++;
+    }
+  });
+}
+
+float
+CountMinSketchModel::conditional_probability(t9_symbol_id_view sequence) const {
+  if (sequence.empty() || sequence.size() > ngram_length) {
+    // Such a sequence is never counted.
+    return 0.0f;
+  }
+
+  uint64_t count = estimate(sequence);
+  if (count == 0) {
+    return 0.0f;
+  }
+
+  uint64_t context_count = sequence.size() == 1 ? n_ngrams : estimate(sequence.substr(0, sequence.size() - 1));
+  return probability(count, context_count);
+}
+
+float
+CountMinSketchModel::conditional_cost(t9_symbol_id_view sequence) const {
+  return -t9::ln(conditional_probability(sequence));
+}
+
+void
+CountMinSketchModel::conditional_costs(t9_symbol_id_view context, std::vector<float> &costs) const {
+  t9_symbol_id_sequence sequence(context);
+  uint64_t context_count;
+
+  std::fill(costs.begin(), costs.end(), unseen_cost);
+
+  if (context.size() >= ngram_length) {
+    // No counted sequence starts with such a context.
+    return;
+  }
+
+  // The count of the context is only estimated once.
+  context_count = context.empty() ? n_ngrams : estimate(context);
+  if (context_count == 0) {
+    return;
+  }
+
+  sequence.push_back(0);
+  for (size_t symbol = 0; symbol < costs.size(); symbol++) {
+    sequence.back() = static_cast<t9_symbol_id>(symbol);
+    costs[symbol] = -t9::ln(probability(estimate(sequence), context_count));
+  }
+}
+
+size_t
+CountMinSketchModel::memory_usage() const {
+  return counters.size() * sizeof(uint32_t);
+}
+
+uint32_t
+CountMinSketchModel::estimate(t9_symbol_id_view sequence) const {
+  uint64_t value = hash_sequence(sequence);
+  uint64_t step = (value >> 32) | 1u;
+  uint32_t count = std::numeric_limits<uint32_t>::max();
+
+  for (size_t row = 0; row < depth; row++) {
+    count = std::min(count, counters[row * width + (value + row * step) % width]);
+  }
+
+  return count;
+}
+
+float
+CountMinSketchModel::probability(uint64_t count, uint64_t context_count) {
+  if (count == 0 || context_count == 0) {
+    return 0.0f;
+  }
+
+  // Overestimated counts may exceed the count of their context.
+  return std::min(1.0f, static_cast<float>(count) / static_cast<float>(context_count));
+}
+
+void
+CountMinSketchModel::locate(t9_symbol_id_view sequence, std::vector<size_t> &cells) const {
+  uint64_t value = hash_sequence(sequence);
+  uint64_t step = (value >> 32) | 1u;
+
+  // Each row uses a different hash, derived from two halves of one hash value.
+  for (size_t row = 0; row < depth; row++) {
+    cells[row] = row * width + (value + row * step) % width;
+  }
+}
+
+void
+CountMinSketchModel::increment(t9_symbol_id_view sequence, std::vector<size_t> &cells) {
+  uint32_t count = std::numeric_limits<uint32_t>::max();
+
+  locate(sequence, cells);
+  for (size_t cell : cells) {
+    count = std::min(count, counters[cell]);
+  }
+
+  if (count == std::numeric_limits<uint32_t>::max()) {
+    // Saturated.
+    return;
+  }
+
+  // Conservative update: Only raise the counters that are below the new estimate.
+  for (size_t cell : cells) {
+    counters[cell] = std::max(counters[cell], count + 1);
+  }
+}
+
+}  // namespace t9
@@ -0,0 +1,490 @@
+// T9 count snapshot -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#include "t9/snapshot.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <system_error>
+
+#include "format.hpp"
+
+// Marker used to detect files written on a machine with a different byte order.
+#define T9_SNAPSHOT_FILE_BYTE_ORDER 0x01020304u
+
+namespace t9 {
+
+namespace {
+/**
+ * Buffered writer appending records to a snapshot file.
+ */
+class RecordWriter {
+ public:
+  RecordWriter(std::ofstream &file, size_t ngram_length)
+      : file(file), buffer_size(T9_SNAPSHOT_BUFFER_RECORDS * (ngram_length + sizeof(uint64_t))), n_records(0) {
+    buffer.reserve(buffer_size);
+  }
+
+  void
+  add(t9_symbol_id_view ngram, uint64_t count) {
+    buffer.insert(buffer.end(), ngram.begin(), ngram.end());
+    buffer.resize(buffer.size() + sizeof(uint64_t));
+    std::memcpy(buffer.data() + buffer.size() - sizeof(uint64_t), &count, sizeof(uint64_t));
+    n_records++;
+
+    if (buffer.size() >= buffer_size) {
+      flush();
+    }
+  }
+
+  void
+  flush() {
+    file.write(reinterpret_cast<const char *>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+    buffer.clear();
+  }
+
+  std::ofstream &file;
+  size_t buffer_size;
+  uint64_t n_records;
+  std::vector<uint8_t> buffer;
+};
+
+/**
+ * Write the full length ngrams of a corpus subtree in lexicographic order.
+ * @param node Root of the subtree.
+ * @param ngram Symbols of the path leading to the node.
+ * @param ngram_length Length of the ngrams stored in the tree.
+ * @param records Writer the ngrams and their counts are appended to.
+ */
+void
+write_ngrams(const CorpusNode *node, t9_symbol_id_sequence &ngram, size_t ngram_length, RecordWriter &records) {
+  if (ngram.size() == ngram_length) {
+    records.add(ngram, node->count);
+    return;
+  }
+
+  // The children are kept in insertion order.
+  std::vector<const CorpusNode *> children(node->children.begin(), node->children.end());
+  std::sort(children.begin(), children.end(), [](const CorpusNode *a, const CorpusNode *b) {
+    return a->symbol < b->symbol;
+  });
+
+  for (auto child : children) {
+    ngram.push_back(child->symbol);
+    write_ngrams(child, ngram, ngram_length, records);
+    ngram.pop_back();
+  }
+}
+}  // namespace
+
+CountSnapshot::CountSnapshot(const std::filesystem::path &file_path)
+    : file_path(file_path), header{}, buffer_position(0), n_read(0) {
+  // Check if the file actually exists.
+  if (!std::filesystem::exists(file_path)) {
+    std::string error_msg = format("Failed to find \"%s\": No such file or directory", file_path.c_str());
+    throw std::runtime_error(error_msg);
+  }
+
+  file.open(file_path, std::ios::in | std::ios::binary);
+  if (file.fail()) {
+    std::string error_msg = format("Failed to open \"%s\"", file_path.c_str());
+    throw std::system_error(errno, std::system_category(), error_msg);
+  }
+
+  if (!file.read(reinterpret_cast<char *>(&header), sizeof(Header))
+      || std::memcmp(header.magic, T9_SNAPSHOT_FILE_MAGIC, sizeof(header.magic)) != 0) {
+    std::string error_msg = format("Failed to read \"%s\": Not a count snapshot file.", file_path.c_str());
+    throw std::runtime_error(error_msg);
+  }
+
+  if (header.version != T9_SNAPSHOT_FILE_VERSION) {
+    std::string error_msg = format("Failed to read \"%s\": Unsupported format version %u (expected %u).",
+                                   file_path.c_str(), header.version, T9_SNAPSHOT_FILE_VERSION);
+    throw std::runtime_error(error_msg);
+  }
+
+  if (header.byte_order != T9_SNAPSHOT_FILE_BYTE_ORDER) {
+    std::string error_msg = format("Failed to read \"%s\": The snapshot was written with a different byte order.",
+                                   file_path.c_str());
+    throw std::runtime_error(error_msg);
+  }
+
+  // Make sure the file holds exactly the announced records.
+  size_t record_size = header.ngram_length + sizeof(uint64_t);
+  if (header.ngram_length == 0
+      || header.n_symbols > sizeof(header.alphabet)
+      || header.n_head > header.ngram_length - 1
+      || header.n_tail > header.ngram_length - 1
+      || std::filesystem::file_size(file_path)
+          != sizeof(Header) + header.n_head + header.n_tail + header.n_records * record_size) {
+    std::string error_msg = format("Failed to read \"%s\": The snapshot is truncated or corrupted.", file_path.c_str());
+    throw std::runtime_error(error_msg);
+  }
+
+  head.resize(header.n_head);
+  tail.resize(header.n_tail);
+  file.read(reinterpret_cast<char *>(head.data()), static_cast<std::streamsize>(head.size()));
+  file.read(reinterpret_cast<char *>(tail.data()), static_cast<std::streamsize>(tail.size()));
+}
+
+void
+CountSnapshot::count(const Corpus &corpus, size_t ngram_length, size_t n_threads,
+                     const std::filesystem::path &file_path) {
+  CorpusTree tree;
+  Header layout{};
+  t9_symbol_id_sequence head;
+  t9_symbol_id_sequence tail;
+  t9_symbol_id_sequence ngram;
+  t9_symbol_sequence alphabet = corpus.get_alphabet();
+
+  if (ngram_length == 0) {
+    std::string error_msg = format("Failed to count \"%s\": The ngram length has to be at least 1.",
+                                   file_path.c_str());
+    throw std::runtime_error(error_msg);
+  }
+
+  // Ngrams spanning the border to a neighbouring shard start within the last and end within the first symbols.
+  size_t border = ngram_length - 1;
+
+  if (corpus.is_streamed()) {
+    size_t n_carried = 0;
+
+    corpus.stream_train_data(border, [&](t9_symbol_id_view window) {
+      tree.insert_sequence(window, ngram_length);
+
+      // Each window starts with the symbols carried over from the previous one.
+      t9_symbol_id_view chunk = window.substr(n_carried);
+      if (head.size() < border) {
+        head.append(chunk.substr(0, border - head.size()));
+      }
+      tail = window.substr(window.size() - std::min(border, window.size()));
+      layout.text_length += chunk.size();
+      n_carried = std::min(border, window.size());
+    });
+  } else {
+    const t9_symbol_id_sequence &text = corpus.get_train_data();
+
+    tree.insert_ngrams(corpus, ngram_length, n_threads);
+    head = text.substr(0, border);
+    tail = text.substr(text.size() - std::min(border, text.size()));
+    layout.text_length = text.size();
+  }
+
+  std::memcpy(layout.magic, T9_SNAPSHOT_FILE_MAGIC, sizeof(layout.magic));
+  layout.version = T9_SNAPSHOT_FILE_VERSION;
+  layout.byte_order = T9_SNAPSHOT_FILE_BYTE_ORDER;
+  layout.ngram_length = ngram_length;
+  layout.n_symbols = alphabet.size();
+  std::memcpy(layout.alphabet, alphabet.data(), alphabet.size());
+  layout.n_head = head.size();
+  layout.n_tail = tail.size();
+
+  std::ofstream file;
+  file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+
+  try {
+    file.open(file_path, std::ios::out | std::ios::binary | std::ios::trunc);
+    write_header(file, layout, head, tail);
+
+    RecordWriter records(file, ngram_length);
+    write_ngrams(tree.root, ngram, ngram_length, records);
+    records.flush();
+
+    // The number of records is only known once all of them were written.
+    layout.n_records = records.n_records;
+    write_header(file, layout, head, tail);
+    file.close();
+  } catch (const std::ios_base::failure &) {
+    std::string error_msg = format("Failed to write \"%s\"", file_path.c_str());
+    throw std::system_error(errno, std::system_category(), error_msg);
+  }
+}
+
+void
+CountSnapshot::merge(const std::vector<std::filesystem::path> &file_paths,
+                     const std::filesystem::path &output_file_path) {
+  std::vector<std::filesystem::path> inputs(file_paths);
+  std::vector<std::filesystem::path> intermediates;
+  std::error_code error;
+
+  if (file_paths.empty()) {
+    std::string error_msg = format("Failed to merge \"%s\": No count snapshots given.", output_file_path.c_str());
+    throw std::runtime_error(error_msg);
+  }
+
+  try {
+    // Merge groups of consecutive snapshots until all remaining ones can be merged at once.
+    for (size_t pass = 0; inputs.size() > T9_SNAPSHOT_MERGE_FAN_IN; pass++) {
+      std::vector<std::filesystem::path> outputs;
+
+      for (size_t begin = 0; begin < inputs.size(); begin += T9_SNAPSHOT_MERGE_FAN_IN) {
+        size_t end = std::min(begin + T9_SNAPSHOT_MERGE_FAN_IN, inputs.size());
+        std::filesystem::path intermediate(output_file_path);
+        intermediate += format(".%zu.%zu.tmp", pass, outputs.size());
+
+        intermediates.push_back(intermediate);
+        merge_pass({inputs.begin() + begin, inputs.begin() + end}, intermediate);
+        outputs.push_back(intermediate);
+      }
+
+      // Intermediate snapshots of the previous pass are no longer needed.
+      if (pass > 0) {
+        for (const auto &input : inputs) {
+          std::filesystem::remove(input, error);
+        }
+      }
+      inputs.swap(outputs);
+    }
+
+    merge_pass(inputs, output_file_path);
+  } catch (...) {
+    for (const auto &intermediate : intermediates) {
+      std::filesystem::remove(intermediate, error);
+    }
+    throw;
+  }
+
+  for (const auto &intermediate : intermediates) {
+    std::filesystem::remove(intermediate, error);
+  }
+}
+
+bool
+CountSnapshot::next(t9_symbol_id_sequence &ngram, uint64_t &count) {
+  size_t record_size = header.ngram_length + sizeof(uint64_t);
+
+  if (buffer_position == buffer.size()) {
+    // Refill the buffer with the following records.
+    uint64_t n_buffered = std::min<uint64_t>(T9_SNAPSHOT_BUFFER_RECORDS, header.n_records - n_read);
+    if (n_buffered == 0) {
+      return false;
+    }
+
+    buffer.resize(n_buffered * record_size);
+    buffer_position = 0;
+    if (!file.read(reinterpret_cast<char *>(buffer.data()), static_cast<std::streamsize>(buffer.size()))) {
+      std::string error_msg = format("Failed to read \"%s\": The snapshot is truncated or corrupted.",
+                                     file_path.c_str());
+      throw std::runtime_error(error_msg);
+    }
+  }
+
+  const uint8_t *record = buffer.data() + buffer_position;
+  ngram.assign(record, record + header.ngram_length);
+  std::memcpy(&count, record + header.ngram_length, sizeof(uint64_t));
+  buffer_position += record_size;
+
+  // Merging relies on the order of the records.
+  if (n_read > 0 && ngram <= previous) {
+    std::string error_msg = format("Failed to read \"%s\": The records are not sorted.", file_path.c_str());
+    throw std::runtime_error(error_msg);
+  }
+  previous = ngram;
+  n_read++;
+
+  return true;
+}
+
+void
+CountSnapshot::rewind() {
+  file.clear();
+  file.seekg(static_cast<std::streamoff>(sizeof(Header) + header.n_head + header.n_tail));
+  buffer.clear();
+  buffer_position = 0;
+  n_read = 0;
+}
+
+void
+CountSnapshot::build_corpus_tree(CorpusTree &tree) {
+  std::vector<CorpusNode *> path;
+  t9_symbol_id_sequence ngram;
+  t9_symbol_id_sequence last;
+  uint64_t count;
+
+  while (next(ngram, count)) {
+    // Each ngram shares the nodes of its common prefix with the previous one.
+    size_t shared = 0;
+    while (shared < path.size() && ngram[shared] == last[shared]) {
+      shared++;
+    }
+
+    path.resize(shared);
+    for (size_t level = shared; level < ngram.size(); level++) {
+      CorpusNode *parent = level == 0 ? tree.root : path.back();
+      path.push_back(parent->get_child_safe(ngram[level]));
+    }
+
+    CorpusNode *parent = tree.root;
+    for (auto node : path) {
+      node->count += count;
+      parent->children_count += count;
+      parent = node;
+    }
+    tree.root->count += count;
+
+    last.swap(ngram);
+  }
+}
+
+size_t
+CountSnapshot::ngram_length() const {
+  return header.ngram_length;
+}
+
+t9_symbol_sequence
+CountSnapshot::alphabet() const {
+  return t9_symbol_sequence(header.alphabet, header.alphabet + header.n_symbols);
+}
+
+size_t
+CountSnapshot::n_records() const {
+  return header.n_records;
+}
+
+size_t
+CountSnapshot::text_length() const {
+  return header.text_length;
+}
+
+void
+CountSnapshot::write_header(std::ofstream &file, const Header &header, t9_symbol_id_view head,
+                            t9_symbol_id_view tail) {
+  file.seekp(0);
+  file.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+  file.write(reinterpret_cast<const char *>(head.data()), static_cast<std::streamsize>(head.size()));
+  file.write(reinterpret_cast<const char *>(tail.data()), static_cast<std::streamsize>(tail.size()));
+}
+
+void
+CountSnapshot::merge_pass(const std::vector<std::filesystem::path> &file_paths,
+                          const std::filesystem::path &output_file_path) {
+  std::vector<std::unique_ptr<CountSnapshot>> snapshots;
+  Header layout{};
+  t9_symbol_id_sequence head;
+  t9_symbol_id_sequence carry;
+  std::vector<t9_symbol_id_sequence> border_ngrams;
+
+  for (const auto &file_path : file_paths) {
+    snapshots.push_back(std::make_unique<CountSnapshot>(file_path));
+  }
+
+  // All snapshots have to be counted with the same parameters.
+  layout = snapshots.front()->header;
+  size_t ngram_length = layout.ngram_length;
+  size_t border = ngram_length - 1;
+  for (const auto &snapshot : snapshots) {
+    if (snapshot->ngram_length() != ngram_length) {
+      std::string error_msg = format("Failed to merge \"%s\": The snapshot was counted with a ngram length of %zu.",
+                                     snapshot->file_path.c_str(), snapshot->ngram_length());
+      throw std::runtime_error(error_msg);
+    }
+    if (snapshot->alphabet() != snapshots.front()->alphabet()) {
+      std::string error_msg = format("Failed to merge \"%s\": The snapshot was counted with different corpus symbols.",
+                                     snapshot->file_path.c_str());
+      throw std::runtime_error(error_msg);
+    }
+  }
+
+  // Collect the ngrams spanning the borders of consecutive shards. Each of them starts within the last symbols of the
+  // preceding shards and ends within the first symbols of the following shard. Shards shorter than the border are
+  // stored completely, hence an ngram can span more than two shards.
+  layout.text_length = 0;
+  for (const auto &snapshot : snapshots) {
+    t9_symbol_id_sequence window = carry + snapshot->head;
+    for (size_t position = 0; position + ngram_length <= window.size(); position++) {
+      border_ngrams.push_back(window.substr(position, ngram_length));
+    }
+
+    if (head.size() < border) {
+      head.append(snapshot->head.substr(0, border - head.size()));
+    }
+    carry.append(snapshot->tail);
+    if (carry.size() > border) {
+      carry.erase(0, carry.size() - border);
+    }
+    layout.text_length += snapshot->header.text_length;
+  }
+  std::sort(border_ngrams.begin(), border_ngrams.end());
+  layout.n_head = head.size();
+  layout.n_tail = carry.size();
+
+  // The current record of each snapshot, the ngrams spanning the borders are read last.
+  size_t n_sources = snapshots.size() + 1;
+  std::vector<t9_symbol_id_sequence> ngrams(n_sources);
+  std::vector<uint64_t> counts(n_sources);
+  size_t n_border_read = 0;
+
+  auto advance = [&](size_t source) {
+    if (source < snapshots.size()) {
+      return snapshots[source]->next(ngrams[source], counts[source]);
+    }
+    if (n_border_read == border_ngrams.size()) {
+      return false;
+    }
+    ngrams[source] = border_ngrams[n_border_read++];
+    counts[source] = 1;
+    return true;
+  };
+
+  // Min-heap of the sources ordered by their current ngram.
+  auto greater = [&ngrams](size_t a, size_t b) {
+    return ngrams[a] > ngrams[b];
+  };
+  std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> queue(greater);
+  for (size_t source = 0; source < n_sources; source++) {
+    if (advance(source)) {
+      queue.push(source);
+    }
+  }
+
+  std::ofstream file;
+  file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+
+  try {
+    file.open(output_file_path, std::ios::out | std::ios::binary | std::ios::trunc);
+    write_header(file, layout, head, carry);
+
+    RecordWriter records(file, ngram_length);
+    t9_symbol_id_sequence ngram;
+
+    while (!queue.empty()) {
+      // Sum the counts of the smallest ngram over all sources.
+      size_t source = queue.top();
+      queue.pop();
+      ngram = ngrams[source];
+      uint64_t count = counts[source];
+      if (advance(source)) {
+        queue.push(source);
+      }
+
+      while (!queue.empty() && ngrams[queue.top()] == ngram) {
+        source = queue.top();
+        queue.pop();
+        count += counts[source];
+        if (advance(source)) {
+          queue.push(source);
+        }
+      }
+
+      records.add(ngram, count);
+    }
+    records.flush();
+
+    layout.n_records = records.n_records;
+    write_header(file, layout, head, carry);
+    file.close();
+  } catch (const std::ios_base::failure &) {
+    std::string error_msg = format("Failed to write \"%s\"", output_file_path.c_str());
+    throw std::system_error(errno, std::system_category(), error_msg);
+  }
+}
+
+}  // namespace t9
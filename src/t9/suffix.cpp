@@ -0,0 +1,193 @@
+// T9 suffix array -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#include "t9/suffix.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "format.hpp"
+
+namespace t9 {
+
+SuffixArray::SuffixArray(const Corpus &corpus) : corpus(corpus) {
+  const t9_symbol_id_sequence &text = corpus.get_train_data();
+  size_t n = text.size();
+
+  if (corpus.is_streamed()) {
+    std::string error_msg = format("Failed to build suffix array: The train data has to be held in memory.");
+    throw std::runtime_error(error_msg);
+  }
+  if (n >= std::numeric_limits<uint32_t>::max()) {
+    std::string error_msg = format("Failed to build suffix array: The train data is too large.");
+    throw std::runtime_error(error_msg);
+  }
+  if (n == 0) {
+    return;
+  }
+
+  std::vector<uint32_t> ranks(n);
+  std::vector<uint32_t> new_ranks(n);
+  std::vector<uint32_t> order(n);
+  std::vector<uint32_t> buckets(std::max<size_t>(n, 256) + 1);
+  uint32_t n_ranks;
+
+  // Sort the suffixes by their first symbol.
+  suffixes.resize(n);
+  for (size_t position = 0; position < n; position++) {
+    buckets[text[position] + 1]++;
+  }
+  for (size_t bucket = 1; bucket < buckets.size(); bucket++) {
+    buckets[bucket] += buckets[bucket - 1];
+  }
+  for (size_t position = 0; position < n; position++) {
+    suffixes[buckets[text[position]]++] = static_cast<uint32_t>(position);
+  }
+
+  ranks[suffixes[0]] = 0;
+  for (size_t index = 1; index < n; index++) {
+    ranks[suffixes[index]] = ranks[suffixes[index - 1]] + (text[suffixes[index]] != text[suffixes[index - 1]]);
+  }
+  n_ranks = ranks[suffixes[n - 1]] + 1;
+
+  // Prefix doubling: Suffixes sorted by their first k symbols are sorted by their first 2k symbols, using the rank of
+  // the suffix starting k symbols later as the secondary key. Suffixes shorter than k already have unique ranks.
+  for (size_t k = 1; n_ranks < n; k *= 2) {
+    size_t next = 0;
+
+    // Order by the secondary key, suffixes without a second half come first.
+    for (size_t position = n - std::min(k, n); position < n; position++) {
+      order[next++] = static_cast<uint32_t>(position);
+    }
+    for (size_t index = 0; index < n; index++) {
+      if (suffixes[index] >= k) {
+        order[next++] = static_cast<uint32_t>(suffixes[index] - k);
+      }
+    }
+
+    // Stable counting sort by the primary key.
+    std::fill(buckets.begin(), buckets.begin() + n_ranks + 1, 0);
+    for (size_t position = 0; position < n; position++) {
+      buckets[ranks[position] + 1]++;
+    }
+    for (size_t bucket = 1; bucket <= n_ranks; bucket++) {
+      buckets[bucket] += buckets[bucket - 1];
+    }
+    for (size_t index = 0; index < n; index++) {
+      suffixes[buckets[ranks[order[index]]]++] = order[index];
+    }
+
+    // Suffixes keep sharing a rank only if both halves are equal.
+    new_ranks[suffixes[0]] = 0;
+    for (size_t index = 1; index < n; index++) {
+      size_t current = suffixes[index];
+      size_t previous = suffixes[index - 1];
+      bool equal = ranks[current] == ranks[previous]
+          && current + k < n
+          && previous + k < n
+          && ranks[current + k] == ranks[previous + k];
+      new_ranks[current] = new_ranks[previous] + (equal ? 0 : 1);
+    }
+    ranks.swap(new_ranks);
+    n_ranks = ranks[suffixes[n - 1]] + 1;
+  }
+
+  // Kasai's algorithm, the common prefix shrinks by at most one symbol from one text position to the next.
+  lcp.assign(n, 0);
+  size_t common = 0;
+  for (size_t position = 0; position < n; position++) {
+    if (ranks[position] == 0) {
+      common = 0;
+      continue;
+    }
+
+    size_t previous = suffixes[ranks[position] - 1];
+    while (position + common < n && previous + common < n && text[position + common] == text[previous + common]) {
+      common++;
+    }
+    lcp[ranks[position]] = static_cast<uint32_t>(common);
+
+    if (common > 0) {
+      common--;
+    }
+  }
+}
+
+size_t
+SuffixArray::count(t9_symbol_id_view ngram) const {
+  t9_symbol_id_view text(corpus.get_train_data());
+
+  // All suffixes starting with the ngram form one interval of the suffix array.
+  auto lower = std::lower_bound(suffixes.begin(), suffixes.end(), ngram,
+                                [&text](uint32_t position, t9_symbol_id_view value) {
+                                  return text.substr(position, value.size()) < value;
+                                });
+  auto upper = std::upper_bound(lower, suffixes.end(), ngram,
+                                [&text](t9_symbol_id_view value, uint32_t position) {
+                                  return value < text.substr(position, value.size());
+                                });
+
+  return static_cast<size_t>(upper - lower);
+}
+
+void
+SuffixArray::build_corpus_tree(size_t ngram_length, CorpusTree &tree) const {
+  const t9_symbol_id_sequence &text = corpus.get_train_data();
+  std::vector<CorpusNode *> path;
+  size_t common = std::numeric_limits<size_t>::max();
+  bool first = true;
+
+  if (ngram_length == 0 || text.size() < ngram_length) {
+    return;
+  }
+
+  // Visit the ngrams in lexicographic order. Each ngram shares its first nodes with the previous one, only the
+  // remaining nodes have to be looked up or created.
+  for (size_t index = 0; index < suffixes.size(); index++) {
+    size_t position = suffixes[index];
+
+    // Common prefix with the previous suffix that was long enough to hold a ngram.
+    if (index > 0) {
+      common = std::min<size_t>(common, lcp[index]);
+    }
+    if (text.size() - position < ngram_length) {
+      continue;
+    }
+
+    size_t shared = first ? 0 : std::min(common, ngram_length);
+    path.resize(shared);
+    for (size_t level = shared; level < ngram_length; level++) {
+      CorpusNode *parent = level == 0 ? tree.root : path.back();
+      path.push_back(parent->get_child_safe(text[position + level]));
+    }
+
+    CorpusNode *parent = tree.root;
+    for (auto node : path) {
+      node->count++;
+      parent->children_count++;
+      parent = node;
+    }
+    tree.root->count++;
+
+    common = std::numeric_limits<size_t>::max();
+    first = false;
+  }
+}
+
+const Corpus &
+SuffixArray::get_corpus() const {
+  return corpus;
+}
+
+size_t
+SuffixArray::memory_usage() const {
+  return suffixes.size() * sizeof(uint32_t) + lcp.size() * sizeof(uint32_t);
+}
+
+}  // namespace t9
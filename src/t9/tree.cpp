@@ -1,11 +1,93 @@
 #include "t9/tree.hpp"
 
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+
 #include "t9/model.hpp"
 
 namespace t9 {
 
+namespace {
+/**
+ * Count the nodes of a subtree.
+ * @param node Root node of the subtree.
+ * @return Number of nodes in the subtree (including the node itself).
+ */
+size_t
+subtree_size(const CorpusNode *node) {
+  size_t n_nodes = 1;
+
+  for (auto child : node->children) {
+    n_nodes += subtree_size(child);
+  }
+
+  return n_nodes;
+}
+
+/**
+ * Calculate the prune scores of all nodes below the first level of a subtree.
+ * @param node Root node of the subtree.
+ * @param criterion Score to calculate.
+ * @param level Level of the node in the tree.
+ * @param scores Collection the scores are stored in.
+ */
+void
+score_subtree(const CorpusNode *node,
+              PruneCriterion criterion,
+              size_t level,
+              std::unordered_map<const CorpusNode *, float> &scores) {
+  for (auto child : node->children) {
+    if (level >= 1) {
+      float score = static_cast<float>(child->count);
+
+      if (criterion == PruneCriterion::ENTROPY) {
+        // Loss of train log likelihood when the node is removed. Its occurrences fall back to the unseen cost, while
+        // the probabilities of its siblings grow by renormalization. The counts are taken after the rare nodes were
+        // removed, as the probabilities are renormalized over the remaining children. The unseen cost is the one all
+        // language models return, -ln(0) clamped by `t9::ln()`. The models do not back off to shorter contexts, so it
+        // outweighs every seen cost: leaves are ordered by their count first and equal counts by the remaining loss.
+        float probability = static_cast<float>(child->count) / static_cast<float>(node->children_count);
+        float siblings_count = static_cast<float>(node->children_count - child->count);
+        float unseen_cost = -t9::ln(0.0f);
+        score = score * (t9::ln(probability) + unseen_cost) + siblings_count * t9::ln(1.0f - probability);
+      }
+
+      scores[child] = score;
+    }
+
+    score_subtree(child, criterion, level + 1, scores);
+  }
+}
+
+/**
+ * Remove all nodes below the first level of a subtree that were seen less than a given number of times.
+ * @param node Root node of the subtree.
+ * @param min_count Minimal count of a node to be kept.
+ * @param level Level of the node in the tree.
+ * @return Number of removed nodes.
+ */
+size_t
+remove_rare_nodes(CorpusNode *node, size_t min_count, size_t level) {
+  size_t n_removed = 0;
+
+  // Iterate over a copy of the children as some of them might be removed.
+  auto children_copy(node->children);
+  for (auto child : children_copy) {
+    if (level >= 1 && child->count < min_count) {
+      n_removed += subtree_size(child);
+      node->remove_child(child);
+    } else {
+      n_removed += remove_rare_nodes(child, min_count, level + 1);
+    }
+  }
+
+  return n_removed;
+}
+}  // namespace
+
 CorpusTree::CorpusTree() {
-  root = new CorpusNode(' ');
+  root = new CorpusNode(T9_INVALID_SYMBOL_ID);
 }
 
 CorpusTree::~CorpusTree() {
@@ -13,52 +95,249 @@ CorpusTree::~CorpusTree() {
 }
 
 void
-CorpusTree::insert_ngrams(const Corpus &corpus, size_t ngram_length) {
-  std::string_view ngram;
-  t9::NGRAMGenerator generator(corpus, ngram_length);
+CorpusTree::insert_ngrams(const Corpus &corpus, size_t ngram_length, size_t n_threads) {
+  size_t n_ngrams = NGRAMGenerator::count_ngrams(corpus, ngram_length);
+
+  if (ngram_length == 0) {
+    return;
+  }
+
+  if (n_threads <= 1 || corpus.is_streamed() || n_ngrams < n_threads) {
+    corpus.stream_train_data(ngram_length - 1, [this, ngram_length](t9_symbol_id_view chunk) {
+      insert_sequence(chunk, ngram_length);
+    });
+    return;
+  }
+
+  std::vector<std::unique_ptr<CorpusTree>> shards;
+  std::vector<std::thread> threads;
+
+  // Count each range of ngrams into a separate shard.
+  for (size_t thread = 0; thread < n_threads; thread++) {
+    size_t begin = n_ngrams * thread / n_threads;
+    size_t end = n_ngrams * (thread + 1) / n_threads;
+
+    shards.push_back(std::make_unique<CorpusTree>());
+    CorpusTree *shard = shards.back().get();
+
+    threads.emplace_back([shard, &corpus, ngram_length, begin, end]() {
+      shard->insert_ngram_range(corpus, ngram_length, begin, end);
+    });
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // Merge all shards into the tree.
+  for (auto &shard : shards) {
+    root->merge(shard->root);
+  }
+}
+
+void
+CorpusTree::insert_sequence(t9_symbol_id_view data, size_t ngram_length) {
+  t9_symbol_id_view ngram;
+  t9::NGRAMGenerator generator(data, ngram_length);
 
   while (!generator.is_done()) {
     ngram = generator.generate_ngram();
     root->insert_ngram(ngram);
+    root->count++;
+  }
+}
+
+void
+CorpusTree::insert_ngram_range(const Corpus &corpus, size_t ngram_length, size_t begin, size_t end) {
+  t9_symbol_id_view ngram;
+  t9::NGRAMGenerator generator(corpus, ngram_length, begin, end);
+
+  while (!generator.is_done()) {
+    ngram = generator.generate_ngram();
+    root->insert_ngram(ngram);
+    root->count++;
   }
 }
 
 void
 CorpusTree::calculate_probabilities() {
   // Count the children of the root node.
-  root->count = 0;
-  for (CorpusNode *child : root->children) {
-    root->count += child->count;
-  }
+  root->count = root->children_count;
 
   // Calculate the conditional probabilities of each node.
   root->calculate_probabilities();
 }
 
 float
-CorpusTree::conditional_probability(const std::string &sequence) const {
-  std::string_view view(sequence);
-
+CorpusTree::conditional_probability(t9_symbol_id_view sequence) const {
   // Find probability of the sequence in tree.
-  return root->conditional_probability(view);
+  return root->conditional_probability(sequence);
+}
+
+float
+CorpusTree::conditional_cost(t9_symbol_id_view sequence) const {
+  return -t9::ln(root->conditional_probability(sequence));
+}
+
+void
+CorpusTree::conditional_costs(t9_symbol_id_view context, std::vector<float> &costs) const {
+  const CorpusNode *node = root;
+
+  std::fill(costs.begin(), costs.end(), -t9::ln(0.0f));
+
+  // Descend the tree to the context node.
+  for (auto symbol : context) {
+    node = node->get_child(symbol);
+    if (node == nullptr) {
+      // Context is not in tree.
+      return;
+    }
+  }
+
+  for (auto child : node->children) {
+    if (child->symbol < costs.size()) {
+      costs[child->symbol] = -t9::ln(static_cast<float>(child->count) / static_cast<float>(node->children_count));
+    }
+  }
+}
+
+void
+CorpusTree::conditional_cost_batch(const std::vector<t9_symbol_id_view> &sequences, std::vector<float> &costs) const {
+  std::vector<const CorpusNode *> nodes(sequences.size(), root);
+  std::vector<const CorpusNode *> parents(sequences.size(), nullptr);
+  size_t max_length = 0;
+
+  for (const auto &sequence : sequences) {
+    max_length = std::max(max_length, sequence.size());
+  }
+
+  for (size_t level = 0; level < max_length; level++) {
+    // Stage 1: The current nodes were prefetched in stage 2 of the previous level. Prefetch the child lookup structures
+    // they point to, which are searched in stage 2.
+    for (size_t index = 0; index < sequences.size(); index++) {
+      if (level < sequences[index].size() && nodes[index] != nullptr) {
+        nodes[index]->prefetch_child(sequences[index][level]);
+      }
+    }
+
+    // Stage 2: Search the children and prefetch the found nodes for the next level. get_child() only reads the lookup
+    // structures of the parent, the children are not touched.
+    for (size_t index = 0; index < sequences.size(); index++) {
+      if (level < sequences[index].size() && nodes[index] != nullptr) {
+        parents[index] = nodes[index];
+        nodes[index] = nodes[index]->get_child(sequences[index][level]);
+
+        if (nodes[index] != nullptr) {
+          // A node may straddle two cache lines.
+          __builtin_prefetch(nodes[index]);
+          __builtin_prefetch(reinterpret_cast<const char *>(nodes[index]) + sizeof(CorpusNode) - 1);
+        }
+      }
+    }
+  }
+
+  costs.resize(sequences.size());
+  for (size_t index = 0; index < sequences.size(); index++) {
+    if (nodes[index] == nullptr || parents[index] == nullptr) {
+      // Sequence is not in tree or empty.
+      costs[index] = -t9::ln(0.0f);
+    } else {
+      costs[index] = -t9::ln(static_cast<float>(nodes[index]->count)
+                                 / static_cast<float>(parents[index]->children_count));
+    }
+  }
+}
+
+size_t
+CorpusTree::memory_usage() const {
+  return root->memory_usage();
+}
+
+size_t
+CorpusTree::size() const {
+  return subtree_size(root);
+}
+
+size_t
+CorpusTree::prune(PruneCriterion criterion, size_t min_count, size_t max_nodes) {
+  // Candidate leaves ordered by their score. Ties are broken by the order the leaves were found in.
+  using Candidate = std::tuple<float, size_t, CorpusNode *>;
+  std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+  std::unordered_map<const CorpusNode *, float> scores;
+  std::vector<CorpusNode *> stack;
+  size_t n_candidates = 0;
+  size_t n_removed;
+  size_t n_nodes;
+
+  n_removed = remove_rare_nodes(root, min_count, 0);
+  if (max_nodes == 0) {
+    return n_removed;
+  }
+
+  // Scores are calculated before leaves are removed, so that they do not depend on the order nodes are removed in.
+  score_subtree(root, criterion, 0, scores);
+
+  // Collect all leaves below the first level.
+  for (auto child : root->children) {
+    stack.push_back(child);
+  }
+  while (!stack.empty()) {
+    CorpusNode *node = stack.back();
+    stack.pop_back();
+
+    if (node->children.empty()) {
+      if (node->get_parent() != root) {
+        candidates.emplace(scores[node], n_candidates++, node);
+      }
+    } else {
+      stack.insert(stack.end(), node->children.begin(), node->children.end());
+    }
+  }
+
+  // Remove the leaves with the lowest scores, parents left without children become leaves themselves.
+  n_nodes = size();
+  while (n_nodes > max_nodes && !candidates.empty()) {
+    CorpusNode *node = std::get<2>(candidates.top());
+    CorpusNode *parent = node->get_parent();
+    candidates.pop();
+
+    parent->remove_child(node);
+    n_nodes--;
+    n_removed++;
+
+    if (parent->children.empty() && parent->get_parent() != root) {
+      candidates.emplace(scores[parent], n_candidates++, parent);
+    }
+  }
+
+  return n_removed;
 }
 
 SearchTree::SearchTree(size_t ngram_length, size_t max_paths)
     : ngram_length(ngram_length),
       max_paths(max_paths),
+      heap(max_paths),
       depth(0) {
-  root = new SearchNode(' ', 0.0f);
+  root = pool.create(T9_INVALID_SYMBOL_ID, 0.0f);
 
   // Prepare memory for the collection of best paths since we know the max. number already.
   best_paths.reserve(max_paths);
 }
 
-SearchTree::~SearchTree() {
-  delete root;
+SearchTree::~SearchTree() = default;
+
+void
+SearchTree::reset() {
+  // All nodes are returned to the pool at once, their slabs are reused by the next search.
+  pool.reset();
+  root = pool.create(T9_INVALID_SYMBOL_ID, 0.0f);
+
+  best_paths.clear();
+  depth = 0;
 }
 
 void
-SearchTree::type(const t9_symbol_sequence &sequence, Model *model) {
+SearchTree::type(const t9_symbol_id_sequence &sequence, Model *model) {
   for (auto symbol : sequence) {
     // Add a new search tree table entry for the new level.
     std::vector<SearchNode *> table;
@@ -69,10 +348,31 @@ SearchTree::type(const t9_symbol_sequence &sequence, Model *model) {
 }
 
 void
-SearchTree::insert(t9_symbol symbol, Model *model) {
-  t9_symbol_sequence sequence;
+SearchTree::insert(t9_symbol_id symbol, Model *model) {
+  std::vector<float> costs(model->corpus.n_symbols());
 
-  root->insert(symbol, sequence, model);
+  // Common ngram lengths use a search specialized at compile time.
+  switch (ngram_length) {
+    case 2:
+      root->insert_fixed<2>(symbol, {}, 0, costs, pool, model);
+      break;
+    case 3:
+      root->insert_fixed<3>(symbol, {}, 0, costs, pool, model);
+      break;
+    case 4:
+      root->insert_fixed<4>(symbol, {}, 0, costs, pool, model);
+      break;
+    case 5:
+      root->insert_fixed<5>(symbol, {}, 0, costs, pool, model);
+      break;
+    case 6:
+      root->insert_fixed<6>(symbol, {}, 0, costs, pool, model);
+      break;
+    default:
+      t9_symbol_id_sequence sequence;
+      root->insert(symbol, sequence, costs, pool, model);
+      break;
+  }
 
   search_paths();
 
@@ -88,10 +388,9 @@ SearchTree::insert(t9_symbol symbol, Model *model) {
 
 void
 SearchTree::search_paths() {
-  best_paths.clear();
-
-  SearchPath path;
-  root->search_paths(path, best_paths, max_paths);
+  heap.clear();
+  root->search_paths(heap);
+  heap.extract(best_paths);
 }
 
 void
@@ -102,7 +401,7 @@ SearchTree::prune() {
 
   SearchPath path;
   // Prune the tree starting at the root node.
-  root->prune(path, best_paths);
+  root->prune(path, best_paths, pool);
 }
 
 }  // namespace t9
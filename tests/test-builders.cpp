@@ -0,0 +1,165 @@
+// T9 model builder tests -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "t9/io.hpp"
+#include "t9/model.hpp"
+#include "t9/snapshot.hpp"
+#include "t9/suffix.hpp"
+
+namespace {
+
+// Sample corpus the models are trained on.
+const std::filesystem::path train_file_path = "data/trump/twitter.txt";
+
+// Number of train symbols loaded from the sample corpus.
+const size_t n_train_symbols = 1000000;
+
+// Length of the ngrams of the compared models.
+const size_t ngram_length = 5;
+
+// Number of paths of the compared models.
+const size_t n_paths = 15;
+
+class BuilderTest : public ::testing::Test {
+ protected:
+  static void
+  SetUpTestSuite() {
+    keyboard = {
+        {'0', SYMBOLS_T0},
+        {'1', SYMBOLS_T1},
+        {'2', SYMBOLS_T2},
+        {'3', SYMBOLS_T3},
+        {'4', SYMBOLS_T4},
+        {'5', SYMBOLS_T5},
+        {'6', SYMBOLS_T6},
+        {'7', SYMBOLS_T7},
+        {'8', SYMBOLS_T8},
+        {'9', SYMBOLS_T9},
+        {'*', SYMBOLS_TS},
+        {'#', SYMBOLS_TR},
+    };
+
+    corpus = std::make_unique<t9::Corpus>(train_file_path, n_train_symbols, train_file_path, 140, keyboard);
+
+    work_dir = std::filesystem::temp_directory_path() / "cpp-t9-test-builders";
+    std::filesystem::create_directories(work_dir);
+
+    // Every build has to write exactly the model file of the serial build.
+    t9::Model model(*corpus, ngram_length, n_paths);
+    model.build_corpus_tree();
+    model.save_corpus_tree(work_dir / "direct.t9");
+    expected_model_file = t9::io::load_text_file(work_dir / "direct.t9", 0);
+  }
+
+  static void
+  TearDownTestSuite() {
+    std::filesystem::remove_all(work_dir);
+    corpus.reset();
+  }
+
+  /**
+   * Save a trained model and read the written model file.
+   * @param model Trained model using the trie backend.
+   * @param name Name of the model file in the working directory.
+   * @return Content of the model file.
+   */
+  static std::string
+  saved_model_file(const t9::Model &model, const std::string &name) {
+    model.save_corpus_tree(work_dir / name);
+    return t9::io::load_text_file(work_dir / name, 0);
+  }
+
+  static std::unordered_map<t9_symbol, t9_symbol_sequence> keyboard;
+  static std::unique_ptr<t9::Corpus> corpus;
+  static std::filesystem::path work_dir;
+  static std::string expected_model_file;
+};
+
+std::unordered_map<t9_symbol, t9_symbol_sequence> BuilderTest::keyboard;
+std::unique_ptr<t9::Corpus> BuilderTest::corpus;
+std::filesystem::path BuilderTest::work_dir;
+std::string BuilderTest::expected_model_file;
+
+TEST_F(BuilderTest, threaded_build_saves_identically) {
+  for (size_t n_threads : {2, 3, 6}) {
+    SCOPED_TRACE("n_threads " + std::to_string(n_threads));
+
+    t9::ModelOptions options;
+    options.n_threads = n_threads;
+    t9::Model model(*corpus, ngram_length, n_paths, options);
+    model.build_corpus_tree();
+
+    // Comparing the sizes first keeps failure messages short.
+    std::string model_file = saved_model_file(model, "threaded.t9");
+    ASSERT_EQ(model_file.size(), expected_model_file.size());
+    EXPECT_TRUE(model_file == expected_model_file);
+  }
+}
+
+TEST_F(BuilderTest, streamed_build_saves_identically) {
+  // Chunks shorter than the ngrams make most ngrams span chunk borders.
+  for (size_t train_chunk_size : {size_t(3), size_t(4096), size_t(1024 * 1024)}) {
+    SCOPED_TRACE("train_chunk_size " + std::to_string(train_chunk_size));
+
+    t9::Corpus streamed_corpus(train_file_path, n_train_symbols, train_file_path, 140, keyboard, train_chunk_size);
+    t9::Model model(streamed_corpus, ngram_length, n_paths);
+    model.build_corpus_tree();
+
+    std::string model_file = saved_model_file(model, "streamed.t9");
+    ASSERT_EQ(model_file.size(), expected_model_file.size());
+    EXPECT_TRUE(model_file == expected_model_file);
+  }
+}
+
+TEST_F(BuilderTest, suffix_array_build_saves_identically) {
+  t9::SuffixArray suffix_array(*corpus);
+  t9::Model model(*corpus, ngram_length, n_paths);
+  model.build_corpus_tree(suffix_array);
+
+  std::string model_file = saved_model_file(model, "suffix.t9");
+  ASSERT_EQ(model_file.size(), expected_model_file.size());
+  EXPECT_TRUE(model_file == expected_model_file);
+}
+
+TEST_F(BuilderTest, merged_snapshots_save_identically) {
+  t9_symbol_sequence text = t9::io::load_text_file(train_file_path, n_train_symbols);
+
+  // Six consecutive shards, three of them shorter than (ngram_length - 1) symbols. Their ngrams only exist across the
+  // borders of the neighbouring shards.
+  const std::vector<size_t> borders = {0, 1, 3, 400000, 400003, 700000, text.size()};
+
+  std::vector<std::filesystem::path> snapshot_file_paths;
+  for (size_t shard = 0; shard + 1 < borders.size(); shard++) {
+    std::filesystem::path shard_file_path = work_dir / ("shard-" + std::to_string(shard) + ".txt");
+    std::filesystem::path snapshot_file_path = work_dir / ("shard-" + std::to_string(shard) + ".counts");
+    t9::io::save_binary_file(shard_file_path, text.data() + borders[shard], borders[shard + 1] - borders[shard]);
+
+    t9::Corpus shard_corpus(shard_file_path, 0, train_file_path, 1, keyboard);
+    t9::Model shard_model(shard_corpus, ngram_length, n_paths);
+    shard_model.save_count_snapshot(snapshot_file_path);
+    snapshot_file_paths.push_back(snapshot_file_path);
+  }
+
+  t9::CountSnapshot::merge(snapshot_file_paths, work_dir / "merged.counts");
+  t9::Model model(*corpus, ngram_length, n_paths);
+  model.load_count_snapshot(work_dir / "merged.counts");
+
+  std::string model_file = saved_model_file(model, "merged.t9");
+  ASSERT_EQ(model_file.size(), expected_model_file.size());
+  EXPECT_TRUE(model_file == expected_model_file);
+}
+
+}  // namespace
@@ -0,0 +1,261 @@
+// T9 decoder tests -*- C++ -*-
+
+// Copyright (C) 2019 Yves-Noel Weweler.
+// All Rights Reserved.
+//
+// Licensed under the MIT License.
+// See LICENSE file in the project root for full license information.
+
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "t9/model.hpp"
+#include "t9/session.hpp"
+
+namespace {
+
+// Number of train symbols loaded from the sample corpus, enough to make most suggestions distinct.
+const size_t n_train_symbols = 1000000;
+
+// Key sequences typed in the tests.
+const std::vector<t9_symbol_sequence> inputs = {
+    "3",
+    "366",
+    "366253",
+    "366253#87867",
+    "8447#46#2886",
+    "*#0#1##2",
+    "4677#46#2886#843",
+};
+
+class DecoderTest : public ::testing::Test {
+ protected:
+  static void
+  SetUpTestSuite() {
+    std::unordered_map<t9_symbol, t9_symbol_sequence> key_2_corpus_table = {
+        {'0', SYMBOLS_T0},
+        {'1', SYMBOLS_T1},
+        {'2', SYMBOLS_T2},
+        {'3', SYMBOLS_T3},
+        {'4', SYMBOLS_T4},
+        {'5', SYMBOLS_T5},
+        {'6', SYMBOLS_T6},
+        {'7', SYMBOLS_T7},
+        {'8', SYMBOLS_T8},
+        {'9', SYMBOLS_T9},
+        {'*', SYMBOLS_TS},
+        {'#', SYMBOLS_TR},
+    };
+
+    corpus = std::make_unique<t9::Corpus>("data/trump/twitter.txt", n_train_symbols,
+                                          "data/trump/twitter.txt", 140, key_2_corpus_table);
+  }
+
+  static void
+  TearDownTestSuite() {
+    corpus.reset();
+  }
+
+  /**
+   * Autocomplete a key sequence with a fresh model.
+   * @param ngram_length Length of the ngrams of the model.
+   * @param n_paths Number of paths of the model.
+   * @param options Options of the model.
+   * @param input Sequence of T9 keys.
+   * @return Suggestions of the model.
+   */
+  static std::vector<std::pair<t9_symbol_sequence, float>>
+  autocomplete(size_t ngram_length, size_t n_paths, const t9::ModelOptions &options, const t9_symbol_sequence &input) {
+    t9::Model model(*corpus, ngram_length, n_paths, options);
+    model.build_corpus_tree();
+    return model.autocomplete(input);
+  }
+
+  static std::unique_ptr<t9::Corpus> corpus;
+};
+
+std::unique_ptr<t9::Corpus> DecoderTest::corpus;
+
+TEST_F(DecoderTest, beam_and_tree_suggest_identically) {
+  t9::ModelOptions beam_options;
+  beam_options.decoder = t9::SearchDecoder::BEAM;
+
+  t9::ModelOptions tree_options;
+  tree_options.decoder = t9::SearchDecoder::TREE;
+
+  for (size_t ngram_length : {1, 2, 3}) {
+    for (size_t n_paths : {1, 5, 15, 40}) {
+      for (const auto &input : inputs) {
+        SCOPED_TRACE("ngram_length " + std::to_string(ngram_length) + ", n_paths " + std::to_string(n_paths)
+                         + ", input \"" + input + "\"");
+        EXPECT_EQ(autocomplete(ngram_length, n_paths, beam_options, input),
+                  autocomplete(ngram_length, n_paths, tree_options, input));
+      }
+    }
+  }
+}
+
+TEST_F(DecoderTest, beam_and_tree_suggest_identically_after_reset) {
+  t9::ModelOptions tree_options;
+  tree_options.decoder = t9::SearchDecoder::TREE;
+
+  t9::Model beam_model(*corpus, 3, 15);
+  t9::Model tree_model(*corpus, 3, 15, tree_options);
+  beam_model.build_corpus_tree();
+  tree_model.build_corpus_tree();
+
+  // Both decoders reuse their memory after a reset.
+  for (const auto &input : inputs) {
+    SCOPED_TRACE("input \"" + input + "\"");
+    beam_model.reset_search_tree();
+    tree_model.reset_search_tree();
+    EXPECT_EQ(beam_model.autocomplete(input), tree_model.autocomplete(input));
+  }
+}
+
+TEST_F(DecoderTest, recombination_keeps_suggestions_of_short_inputs) {
+  t9::ModelOptions options;
+  options.paths_per_state = 0;
+
+  // Until ngram_length keys are typed, all paths differ in their last (ngram_length - 1) symbols.
+  for (size_t ngram_length : {2, 3, 4}) {
+    for (size_t n_paths : {1, 5, 15}) {
+      t9::Model model(*corpus, ngram_length, n_paths, options);
+      model.build_corpus_tree();
+
+      for (size_t paths_per_state : {1, 2}) {
+        t9::ModelOptions recombined_options;
+        recombined_options.paths_per_state = paths_per_state;
+        t9::Model recombined_model(*corpus, ngram_length, n_paths, recombined_options);
+        recombined_model.build_corpus_tree();
+
+        for (const auto &input : inputs) {
+          t9_symbol_sequence prefix = input.substr(0, ngram_length - 1);
+          SCOPED_TRACE("ngram_length " + std::to_string(ngram_length) + ", n_paths " + std::to_string(n_paths)
+                           + ", paths_per_state " + std::to_string(paths_per_state) + ", input \"" + prefix + "\"");
+
+          model.reset_search_tree();
+          recombined_model.reset_search_tree();
+          EXPECT_EQ(recombined_model.autocomplete(prefix), model.autocomplete(prefix));
+        }
+      }
+    }
+  }
+}
+
+TEST_F(DecoderTest, recombination_keeps_paths_of_distinct_states) {
+  t9::ModelOptions options;
+  options.paths_per_state = 1;
+
+  for (size_t ngram_length : {2, 3, 4}) {
+    for (const auto &input : inputs) {
+      SCOPED_TRACE("ngram_length " + std::to_string(ngram_length) + ", input \"" + input + "\"");
+      auto suggestions = autocomplete(ngram_length, 15, options, input);
+      ASSERT_FALSE(suggestions.empty());
+
+      // No two suggestions end in the same (ngram_length - 1) symbols once pruning started.
+      if (input.size() >= ngram_length) {
+        std::set<t9_symbol_sequence> states;
+        for (const auto &[text, score] : suggestions) {
+          EXPECT_TRUE(states.insert(text.substr(text.size() - (ngram_length - 1))).second);
+        }
+      }
+    }
+  }
+}
+
+TEST_F(DecoderTest, backspace_restores_suggestions) {
+  for (size_t max_checkpoints : {0, 2, T9_SESSION_MAX_CHECKPOINTS}) {
+    SCOPED_TRACE("max_checkpoints " + std::to_string(max_checkpoints));
+
+    t9::Model model(*corpus, 3, 15);
+    model.build_corpus_tree();
+    t9::TypingSession session(model, max_checkpoints);
+
+    // Suggestions before each key of the input.
+    const t9_symbol_sequence input = "366253#87867#4677";
+    std::vector<std::vector<std::pair<t9_symbol_sequence, float>>> history;
+    for (auto key : input) {
+      history.push_back(session.suggestions());
+      session.type(key);
+    }
+    EXPECT_EQ(session.latencies_ms().size(), input.size());
+
+    // Each backspace restores the exact suggestions before the erased key.
+    while (!history.empty()) {
+      EXPECT_EQ(session.backspace(), history.back());
+      history.pop_back();
+    }
+    EXPECT_TRUE(session.keys().empty());
+    EXPECT_TRUE(session.suggestions().empty());
+
+    // Typing again after erasing suggests like typing all keys at once.
+    session.type('3');
+    session.type('6');
+    session.type('7');
+    session.backspace();
+    session.type('6');
+    EXPECT_EQ(session.suggestions(), model.autocomplete("366"));
+  }
+}
+
+TEST_F(DecoderTest, model_rejects_empty_ngrams) {
+  EXPECT_THROW(t9::Model(*corpus, 0, 5), std::invalid_argument);
+}
+
+TEST_F(DecoderTest, model_rejects_invalid_key_probabilities) {
+  t9::ModelOptions options;
+  options.key_probability = 1.5f;
+  EXPECT_THROW(t9::Model(*corpus, 2, 5, options), std::invalid_argument);
+
+  // The key and its four neighbours are pressed with a probability of more than 1.
+  options.key_probability = 0.9f;
+  options.neighbour_keys = {{'5', "2468"}};
+  options.neighbour_key_probability = 0.05f;
+  EXPECT_THROW(t9::Model(*corpus, 2, 5, options), std::invalid_argument);
+
+  options.key_probability = 0.8f;
+  EXPECT_NO_THROW(t9::Model(*corpus, 2, 5, options));
+}
+
+TEST_F(DecoderTest, long_typing_session_compacts_history) {
+  t9::Model model(*corpus, 3, 15);
+  model.build_corpus_tree();
+  t9::BeamDecoder decoder(3, 15, 0, 4);
+
+  // Every key appends the symbols of its surviving paths, the history is compacted before it grows out of bounds.
+  const t9_symbol_sequence input = "366253#87867#4677#46#2886#";
+  for (size_t repetition = 0; repetition < 100; repetition++) {
+    for (auto key : input) {
+      decoder.insert(model.corpus.key_id(key), &model);
+    }
+  }
+  EXPECT_LT(decoder.history_size(), input.size() * 100 * 15 / 2);
+
+  // Paths and checkpoints are still intact.
+  std::vector<std::pair<t9_symbol_id_sequence, float>> paths;
+  decoder.best_paths(paths);
+  ASSERT_EQ(paths.size(), 15u);
+  EXPECT_EQ(paths.front().first.size(), input.size() * 100);
+  EXPECT_TRUE(decoder.erase());
+  decoder.best_paths(paths);
+  EXPECT_EQ(paths.front().first.size(), input.size() * 100 - 1);
+}
+
+TEST_F(DecoderTest, typing_session_rejects_invalid_keys) {
+  t9::Model model(*corpus, 2, 5);
+  model.build_corpus_tree();
+  t9::TypingSession session(model);
+
+  EXPECT_THROW(session.type('x'), std::runtime_error);
+  EXPECT_TRUE(session.keys().empty());
+}
+
+}  // namespace